@@ -15,6 +15,7 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <getopt.h>
 
@@ -22,14 +23,63 @@
 #include "mandelbrot.h"
 #include "ppm.h"
 
+// maximum number of iteration limits that are rendered in one pass
+#define MAX_LIMITS 16
+
+// rows per band when --mmap has to fall back to --bands
+#define FALLBACK_BAND 256
+
+// names of the formulas for --formula, indexed by the FORMULA_ constants
+static const char *formulaNames[] = {"mandelbrot", "julia", "multibrot3", "multibrot4", "burningship"};
+#define FORMULA_NAME_COUNT (int)(sizeof(formulaNames) / sizeof(formulaNames[0]))
+
 struct arguments {
-    int maxIterations;
+    int limits[MAX_LIMITS];   // requested maxIterations values, ascending
+    int limitCount;
     char * outfile;
+    deepfloat centerRe;
+    deepfloat centerIm;
+    double zoom;
+    int perturbation;
+    int doubleDouble;
+    int subdivision;
+    int antialias;
+    int distance;
+    int histogram;
+    int formula;
+    complex double seed;
+    char * loadfile;
+    char * savefile;
+    int format;
+    int width;
+    int height;
+    int band;
+    int mapped;
 };
 
 static struct option long_options[] = {
     {"maxiterations", required_argument, 0, 'i'},
     {"outfile", required_argument, 0, 'o'},
+    {"centerx", required_argument, 0, 'x'},
+    {"centery", required_argument, 0, 'y'},
+    {"zoom", required_argument, 0, 'z'},
+    {"perturbation", no_argument, 0, 'p'},
+    {"doubledouble", no_argument, 0, 'd'},
+    {"subdivision", no_argument, 0, 's'},
+    {"tilesize", required_argument, 0, 't'},
+    {"antialias", required_argument, 0, 'a'},
+    {"distance", no_argument, 0, 'e'},
+    {"formula", required_argument, 0, 'f'},
+    {"seed", required_argument, 0, 'c'},
+    {"palette", required_argument, 0, 'P'},
+    {"offset", required_argument, 0, 'O'},
+    {"histogram", no_argument, 0, 'H'},
+    {"save", required_argument, 0, 'S'},
+    {"load", required_argument, 0, 'L'},
+    {"ascii", no_argument, 0, 'A'},
+    {"resolution", required_argument, 0, 'r'},
+    {"bands", required_argument, 0, 'B'},
+    {"mmap", no_argument, 0, 'M'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
 };
@@ -39,11 +89,113 @@ help(void)
 {
     printf("USAGE: mandelbrot_cli [OPTIONS]\n");
     printf("With [OPTIONS]:\n");
-    printf("\t -i --maxiterations INT \t maximum number of series iterations per pixel\n");
+    printf("\t -i --maxiterations INT[,INT...] \t maximum number of series iterations per pixel; several limits are rendered\n");
+    printf("\t\t\t\t\t in one pass into one picture each, named with the limit appended (e.g. mandelbrot_100.ppm)\n");
     printf("\t -o --outfile FILE \t filename (without appendix) for output picture in PPM format\n");
+    printf("\t -x --centerx NUMBER \t real part of the centre of the view (any number of digits)\n");
+    printf("\t -y --centery NUMBER \t imaginary part of the centre of the view (any number of digits)\n");
+    printf("\t -z --zoom FLOAT \t magnification relative to the initial view\n");
+    printf("\t -p --perturbation \t always use perturbation theory (chosen automatically for zooms beyond double precision,\n");
+    printf("\t\t\t\t down to about 1e-300 per pixel)\n");
+    printf("\t -d --doubledouble \t iterate every pixel in double-double precision (zooms down to about 1e-30 per pixel)\n");
+    printf("\t -s --subdivision \t fill rectangles with a uniform border without iterating them (Mariani-Silver)\n");
+    printf("\t -t --tilesize WxH \t size of the tiles the threads take turns on (e.g. 128x16, a single number for square tiles)\n");
+    printf("\t -a --antialias INT \t anti-alias edges with INT x INT jittered samples per pixel (not for perturbation and double-double)\n");
+    printf("\t -e --distance \t\t draw the distance to the set in grey levels, showing thin filaments; discs that are\n");
+    printf("\t\t\t\t certainly outside the set are filled without iterating them (up to double precision zooms)\n");
+    printf("\t -f --formula NAME \t iterate mandelbrot (default), julia, multibrot3 (z^3 + c), multibrot4 (z^4 + c) or\n");
+    printf("\t\t\t\t burningship instead; the other formulas use the plain kernel only\n");
+    printf("\t -c --seed RE,IM \t constant c of the Julia set (default -0.8,0.156)\n");
+    printf("\t -P --palette FILE \t colour with the palette in FILE instead of the YUV scheme; one colour per line\n");
+    printf("\t\t\t\t as \"R G B\" from 0 to 255, spread from 0 to the iteration limit\n");
+    printf("\t -O --offset FLOAT \t shift the colours by FLOAT times the iteration limit, wrapping around (colour cycling)\n");
+    printf("\t -H --histogram \t spread the colours by histogram equalisation instead of evenly up to the iteration limit\n");
+    printf("\t -S --save FILE \t also save the iteration field to FILE (one per limit, named like the pictures)\n");
+    printf("\t -A --ascii \t\t write the pictures as ASCII PPM (P3) instead of binary (P6)\n");
+    printf("\t -r --resolution WxH \t size of the picture in pixels (default 1024x768); the view keeps its height and\n");
+    printf("\t\t\t\t widens or narrows with the aspect ratio\n");
+    printf("\t -B --bands ROWS \t render the picture in bands of ROWS rows, each written to the file (P6) as soon as it is\n");
+    printf("\t\t\t\t done, so memory stays bounded for any size; plain kernel and colours only (no -s, -e, -a, -H, -S)\n");
+    printf("\t -M --mmap \t\t like --bands, but the threads write the pixels straight into the memory-mapped file\n");
+    printf("\t\t\t\t (where the system supports it, in bands otherwise)\n");
+    printf("\t -L --load FILE \t colour the iteration field saved in FILE instead of iterating; only -o, -P, -O, -H and -A apply\n");
     printf("\n");
 }
 
+/*
+ * Parses a comma-separated list of iteration limits, sorted ascending and without duplicates
+ *
+ * Arguments:
+ *  list - The list from the command line
+ *  limits - Receives up to MAX_LIMITS limits
+ *
+ * Returns:
+ *  The number of limits
+ */
+static int
+parseLimits(const char *list, int *limits)
+{
+    int count = 0;
+    char *end;
+
+    while(count < MAX_LIMITS) {
+        long limit = strtol(list, &end, 10);
+        if(end == list) {
+            break;
+        }
+        limit = limit < 2 ? 2 : limit;
+        limit = limit > 10000 ? 10000 : limit;
+
+        // sortiert einfügen, doppelte Grenzen nur einmal
+        int i = count;
+        while(i > 0 && limits[i - 1] > limit) {
+            limits[i] = limits[i - 1];
+            i--;
+        }
+        if(i > 0 && limits[i - 1] == limit) {
+            memmove(&limits[i], &limits[i + 1], (count - i) * sizeof(int));
+        } else {
+            limits[i] = limit;
+            count++;
+        }
+
+        if(*end != ',') {
+            break;
+        }
+        list = end + 1;
+    }
+
+    return count;
+}
+
+/*
+ * Builds the file name of the picture for one of several limits by appending the limit
+ * to the name of the file, e.g. mandelbrot.ppm becomes mandelbrot_100.ppm
+ *
+ * Arguments:
+ *  outfile - The file name from the command line
+ *  limit - The iteration limit
+ *
+ * Returns:
+ *  The new file name, to be freed by the caller
+ */
+static char *
+limitFilename(const char *outfile, int limit)
+{
+    size_t size = strlen(outfile) + 16;
+    char *filename = malloc(size);
+
+    // die Endung beginnt beim letzten Punkt hinter dem letzten Verzeichnistrenner
+    const char *extension = strrchr(outfile, '.');
+    const char *directory = strrchr(outfile, '/');
+    if(extension == NULL || (directory != NULL && extension < directory)) {
+        extension = outfile + strlen(outfile);
+    }
+
+    snprintf(filename, size, "%.*s_%d%s", (int)(extension - outfile), outfile, limit, extension);
+    return filename;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -53,14 +205,33 @@ main(int argc, char *argv[])
 
     // argument parsing
     struct arguments args;
-    args.maxIterations = 100;
+    args.limits[0] = 100;
+    args.limitCount = 1;
     args.outfile = "mandelbrot.ppm";
+    args.centerRe = deepFromDouble((creal(INITIAL_UPPERLEFT) + creal(INITIAL_LOWERRIGHT)) / 2);
+    args.centerIm = deepFromDouble((cimag(INITIAL_UPPERLEFT) + cimag(INITIAL_LOWERRIGHT)) / 2);
+    args.zoom = 1;
+    args.perturbation = 0;
+    args.doubleDouble = 0;
+    args.subdivision = 0;
+    args.antialias = 1;
+    args.distance = 0;
+    args.histogram = 0;
+    args.formula = FORMULA_MANDELBROT;
+    args.seed = DEFAULT_JULIA_SEED;
+    args.loadfile = NULL;
+    args.savefile = NULL;
+    args.format = PPM_BINARY;
+    args.width = WIDTH;
+    args.height = HEIGHT;
+    args.band = 0;
+    args.mapped = 0;
     int c = 0;
 
     while(1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "hi:o:", long_options, &option_index);
+        c = getopt_long(argc, argv, "hi:o:x:y:z:pdst:a:ef:c:P:O:HS:L:Ar:B:M", long_options, &option_index);
 
         // exit loop after parsing all arguments
         if(c == -1) {
@@ -73,38 +244,373 @@ main(int argc, char *argv[])
                 exit(0);
                 break;
             case 'i':
-                args.maxIterations = atoi(optarg);
-                if(args.maxIterations < 2) {
-                    args.maxIterations = 2;
+                args.limitCount = parseLimits(optarg, args.limits);
+                if(args.limitCount == 0) {
+                    printf("Invalid iteration limits, terminating...\n");
+                    exit(-1);
                 }
-                if(args.maxIterations > 10000) {
-                    args.maxIterations = 10000;
+                printf("Maximum iterations:");
+                for(int i = 0; i < args.limitCount; i++) {
+                    printf(" %d", args.limits[i]);
                 }
-                printf("Maximum iterations: %d\n", args.maxIterations);
+                printf("\n");
                 break;
             case 'o':
                 args.outfile = optarg;
                 printf("Result file: %s\n", args.outfile);
                 break;
+            case 'x':
+                args.centerRe = parseDeepFloat(optarg);
+                printf("Centre (real part): %s\n", optarg);
+                break;
+            case 'y':
+                args.centerIm = parseDeepFloat(optarg);
+                printf("Centre (imaginary part): %s\n", optarg);
+                break;
+            case 'z':
+                args.zoom = atof(optarg);
+                if(args.zoom < 1) {
+                    args.zoom = 1;
+                }
+                printf("Zoom: %g\n", args.zoom);
+                break;
+            case 'p':
+                args.perturbation = 1;
+                break;
+            case 'd':
+                args.doubleDouble = 1;
+                break;
+            case 's':
+                args.subdivision = 1;
+                break;
+            case 't': {
+                int tileWidth = 0;
+                int tileHeight = 0;
+                if(sscanf(optarg, "%dx%d", &tileWidth, &tileHeight) < 2) {
+                    tileHeight = tileWidth;
+                }
+                setMandelbrotTileSize(tileWidth, tileHeight);
+                printf("Tile size: %dx%d\n", tileWidth, tileHeight);
+                break;
+            }
+            case 'a':
+                args.antialias = atoi(optarg);
+                if(args.antialias > 8) {
+                    args.antialias = 8;
+                }
+                printf("Anti-aliasing: %dx%d samples per edge pixel\n", args.antialias, args.antialias);
+                break;
+            case 'e':
+                args.distance = 1;
+                break;
+            case 'f':
+                args.formula = -1;
+                for(int f = 0; f < FORMULA_NAME_COUNT; f++) {
+                    if(strcmp(optarg, formulaNames[f]) == 0) {
+                        args.formula = f;
+                    }
+                }
+                if(args.formula < 0) {
+                    printf("Unknown formula %s, terminating...\n", optarg);
+                    exit(-1);
+                }
+                printf("Formula: %s\n", formulaNames[args.formula]);
+                break;
+            case 'c': {
+                double re = 0;
+                double im = 0;
+                if(sscanf(optarg, "%lf,%lf", &re, &im) < 2) {
+                    printf("Invalid Julia seed %s, terminating...\n", optarg);
+                    exit(-1);
+                }
+                args.seed = re + im * I;
+                printf("Julia seed: %g%+gi\n", re, im);
+                break;
+            }
+            case 'P':
+                if(loadMandelbrotPalette(optarg) != 0) {
+                    printf("Cannot read a palette of at least two colours from %s, terminating...\n", optarg);
+                    exit(-1);
+                }
+                printf("Palette: %s\n", optarg);
+                break;
+            case 'O':
+                setMandelbrotColorOffset(atof(optarg));
+                printf("Colour offset: %g\n", atof(optarg));
+                break;
+            case 'H':
+                args.histogram = 1;
+                setMandelbrotEqualization(1);
+                printf("Histogram equalisation\n");
+                break;
+            case 'S':
+                args.savefile = optarg;
+                printf("Iteration field file: %s\n", args.savefile);
+                break;
+            case 'L':
+                args.loadfile = optarg;
+                printf("Colouring iteration field from %s\n", args.loadfile);
+                break;
+            case 'A':
+                args.format = PPM_ASCII;
+                break;
+            case 'r':
+                if(sscanf(optarg, "%dx%d", &args.width, &args.height) < 2 || args.width < 1 || args.height < 1) {
+                    printf("Invalid resolution %s, terminating...\n", optarg);
+                    exit(-1);
+                }
+                printf("Resolution: %dx%d\n", args.width, args.height);
+                break;
+            case 'B':
+                args.band = atoi(optarg);
+                if(args.band < 1) {
+                    args.band = 1;
+                }
+                printf("Rendering in bands of %d rows\n", args.band);
+                break;
+            case 'M':
+                args.mapped = 1;
+                break;
             default:
                 printf("Unknown option, terminating...\n");
                 exit(-1);
         }
     }
 
-    gettimeofday(&start, 0);
-    unsigned char *data = generateMandelbrot(INITIAL_UPPERLEFT, INITIAL_LOWERRIGHT, args.maxIterations, WIDTH, HEIGHT);
-    gettimeofday(&stop, 0);
+    // a saved field only needs colouring, the view it shows is not known any more
+    if(args.loadfile) {
+        int maxIterations, width, height;
+        float *iterations = loadMandelbrotField(args.loadfile, &maxIterations, &width, &height);
+        if(iterations == NULL) {
+            printf("Cannot read an iteration field from %s, terminating...\n", args.loadfile);
+            exit(-1);
+        }
+
+        gettimeofday(&start, 0);
+        struct PPM image;
+        image.width = width;
+        image.height = height;
+        image.data = maxIterations > 0 ? colorizeMandelbrot(iterations, maxIterations, width, height)
+                                       : colorizeDistance(iterations, width, height);
+        gettimeofday(&stop, 0);
+
+        printf("Writing image %s...\n", args.outfile);
+        exportPPM(args.outfile, &image, args.format);
+        free(iterations);
+        free(image.data);
+
+        printf("Colouring took %ld ms...\n", (stop.tv_sec-start.tv_sec)*1000 + (stop.tv_usec-start.tv_usec)/1000);
+        return 0;
+    }
+
+    // view from centre and zoom, the initial view defines the aspect ratio of a pixel
+    double aspect = ((double)args.width * HEIGHT) / ((double)args.height * WIDTH);
+    double spanRe = (creal(INITIAL_LOWERRIGHT) - creal(INITIAL_UPPERLEFT)) / args.zoom * aspect;
+    double spanIm = (cimag(INITIAL_UPPERLEFT) - cimag(INITIAL_LOWERRIGHT)) / args.zoom;
+    complex double upperLeft = (deepToDouble(&args.centerRe) - spanRe/2) + (deepToDouble(&args.centerIm) + spanIm/2) * I;
+    complex double lowerRight = (deepToDouble(&args.centerRe) + spanRe/2) + (deepToDouble(&args.centerIm) - spanIm/2) * I;
+
+    // the other formulas only have variants of the plain kernel
+    if(args.formula != FORMULA_MANDELBROT) {
+        if(args.perturbation || args.doubleDouble || args.subdivision || args.distance || args.antialias > 1) {
+            printf("Formula %s only uses the plain kernel, ignoring the other modes\n", formulaNames[args.formula]);
+        }
+        args.perturbation = 0;
+        args.doubleDouble = 0;
+        args.subdivision = 0;
+        args.distance = 0;
+        args.antialias = 1;
+        setMandelbrotFormula(args.formula, args.seed);
+    } else if(!args.perturbation && !args.doubleDouble && needsPerturbation(upperLeft, lowerRight, args.width, args.height)) {
+        args.perturbation = 1;
+    }
+
+    // the derivative is iterated in double at most
+    if(args.distance && (args.perturbation || args.doubleDouble)) {
+        printf("Distance estimation is not available at this zoom, drawing iterations instead\n");
+        args.distance = 0;
+    }
+
+    // without mmap the same picture is written in bands
+    if(args.mapped && !PPM_MAPPED) {
+        if(!args.band) {
+            args.band = FALLBACK_BAND;
+        }
+        printf("Memory-mapped files are not supported on this system, rendering in bands of %d rows instead\n", args.band);
+        args.mapped = 0;
+    }
+
+    // bands only see their own rows, the other modes need the whole picture
+    if(args.band || args.mapped) {
+        if(args.perturbation || args.doubleDouble) {
+            printf("Rendering in bands needs a view within double precision, terminating...\n");
+            exit(-1);
+        }
+        // each band is coloured and written on its own, so nothing sees the whole field
+        char ignored[32] = "";
+        if(args.subdivision) {
+            strcat(ignored, " -s");
+        }
+        if(args.distance) {
+            strcat(ignored, " -e");
+        }
+        if(args.antialias > 1) {
+            strcat(ignored, " -a");
+        }
+        if(args.histogram) {
+            strcat(ignored, " -H");
+        }
+        if(args.savefile) {
+            strcat(ignored, " -S");
+        }
+        if(ignored[0]) {
+            printf("Rendering in bands only uses the plain kernel and colours, ignoring%s\n", ignored);
+        }
+        printf("Using %s kernel, rendering %s\n", mandelbrotKernelName(), args.mapped ? "into the mapped file" : "in bands");
+
+        size_t row = (size_t)args.width * 3;
+        size_t bandSize = args.band * row;
+        unsigned char *band = args.mapped ? NULL : malloc(bandSize);
+        if(!args.mapped && band == NULL) {
+            printf("Cannot allocate %zu bytes for a band, terminating...\n", bandSize);
+            exit(-1);
+        }
+
+        gettimeofday(&start, 0);
+        for(int l = 0; l < args.limitCount; l++) {
+            int maxIterations = args.limits[l];
+            char *filename = args.limitCount > 1 ? limitFilename(args.outfile, maxIterations) : args.outfile;
+            printf("Writing image %s...\n", filename);
+
+            int error;
+            if(args.mapped) {
+                // the file starts with the bottom row, so the first row of the picture is the last one of the file
+                struct PPMMap map;
+                error = mapPPM(filename, args.width, args.height, &map) != 0;
+                if(!error) {
+                    renderMandelbrotBand(upperLeft, lowerRight, maxIterations, args.width, args.height, 0, args.height,
+                                         map.data + (args.height - 1) * row, -(ptrdiff_t)row);
+                    error = unmapPPM(&map) != 0;
+                }
+            } else {
+                // the file starts with the bottom row, so the bands go from the bottom to the top
+                FILE *file = beginPPM(filename, args.width, args.height);
+                error = file == NULL;
+                for(int bottom = args.height; bottom > 0 && !error; bottom -= args.band) {
+                    int rows = bottom < args.band ? bottom : args.band;
+                    renderMandelbrotBand(upperLeft, lowerRight, maxIterations, args.width, args.height, bottom - rows, rows,
+                                         band, row);
+                    error = writePPMBand(file, band, args.width, rows) != 0;
+                }
+                if(file != NULL) {
+                    error |= endPPM(file) != 0;
+                }
+            }
+            if(error) {
+                printf("Error saving image!\n");
+            }
+
+            if(filename != args.outfile) {
+                free(filename);
+            }
+        }
+        gettimeofday(&stop, 0);
+        free(band);
+
+        printf("Rendering took %ld ms...\n", (stop.tv_sec-start.tv_sec)*1000 + (stop.tv_usec-start.tv_usec)/1000);
+        return 0;
+    }
+
+    if(args.distance) {
+        printf("Using %s kernel with distance estimation\n", mandelbrotKernelName());
+    } else if(args.doubleDouble) {
+        printf("Using double-double %s kernel\n", mandelbrotKernelName());
+    } else if(args.perturbation) {
+        printf("Using perturbation theory\n");
+    } else if(args.subdivision) {
+        printf("Using %s kernel with subdivision\n", mandelbrotKernelName());
+    } else if(args.formula != FORMULA_MANDELBROT) {
+        printf("Using %s kernel for %s\n", mandelbrotKernelName(), formulaNames[args.formula]);
+    } else {
+        printf("Using %s kernel\n", mandelbrotKernelName());
+    }
+
+    // iterating and colouring are separate stages, a saved iteration field can be coloured again with --load
+    long iterationTime = 0;
+    long colorTime = 0;
 
-    long renderTime = (stop.tv_sec-start.tv_sec)*1000 + (stop.tv_usec-start.tv_usec)/1000;
-    printf("Rendering took %ld ms...\n", renderTime);
+    // several limits continue the same pixels, so the whole pass costs as much as the largest limit alone
+    struct MandelbrotState state = {0};
+    int resumable = args.limitCount > 1 && !args.doubleDouble && !args.perturbation && !args.subdivision && !args.distance
+                 && args.formula == FORMULA_MANDELBROT;
+
+    for(int l = 0; l < args.limitCount; l++) {
+        int maxIterations = args.limits[l];
+
+        gettimeofday(&start, 0);
+        float *iterations;
+        if(args.distance) {
+            iterations = estimateMandelbrotDistance(upperLeft, lowerRight, maxIterations, args.width, args.height, 1);
+        } else if(resumable) {
+            iterations = iterateMandelbrotResumable(&state, upperLeft, lowerRight, maxIterations, args.width, args.height);
+        } else if(args.doubleDouble) {
+            iterations = iterateMandelbrotDoubleDouble(args.centerRe, args.centerIm, spanRe, spanIm, maxIterations, args.width, args.height);
+        } else if(args.perturbation) {
+            iterations = iterateMandelbrotPerturbation(args.centerRe, args.centerIm, spanRe, spanIm, maxIterations, args.width, args.height);
+        } else if(args.subdivision) {
+            iterations = iterateMandelbrotSubdivision(upperLeft, lowerRight, maxIterations, args.width, args.height);
+        } else {
+            iterations = iterateMandelbrot(upperLeft, lowerRight, maxIterations, args.width, args.height);
+        }
+        gettimeofday(&stop, 0);
+        iterationTime += (stop.tv_sec-start.tv_sec)*1000 + (stop.tv_usec-start.tv_usec)/1000;
+
+        gettimeofday(&start, 0);
+        unsigned char *data;
+        if(args.distance) {
+            data = colorizeDistance(iterations, args.width, args.height);
+        } else {
+            data = colorizeMandelbrot(iterations, maxIterations, args.width, args.height);
+        }
+        // the extra samples are iterated in double at most, deep zooms keep one sample per pixel
+        if(!args.perturbation && !args.doubleDouble && !args.distance) {
+            antialiasMandelbrot(iterations, data, upperLeft, lowerRight, maxIterations, args.width, args.height,
+                                args.antialias, DEFAULT_ANTIALIAS_THRESHOLD);
+        }
+        gettimeofday(&stop, 0);
+        colorTime += (stop.tv_sec-start.tv_sec)*1000 + (stop.tv_usec-start.tv_usec)/1000;
+
+        if(args.savefile) {
+            // distance fields are marked with a limit of 0
+            char *fieldname = args.limitCount > 1 ? limitFilename(args.savefile, maxIterations) : args.savefile;
+            if(saveMandelbrotField(fieldname, iterations, args.distance ? 0 : maxIterations, args.width, args.height) != 0) {
+                printf("Error saving iteration field %s!\n", fieldname);
+            }
+            if(fieldname != args.savefile) {
+                free(fieldname);
+            }
+        }
+
+        char *filename = args.limitCount > 1 ? limitFilename(args.outfile, maxIterations) : args.outfile;
+        printf("Writing image %s...\n", filename);
+        struct PPM image;
+        image.width = args.width;
+        image.height = args.height;
+        image.data = data;
+        exportPPM(filename, &image, args.format);
+
+        if(filename != args.outfile) {
+            free(filename);
+        }
+        if(!resumable) {
+            free(iterations);
+        }
+        free(data);
+    }
+    freeMandelbrotState(&state);
 
-    printf("Writing image...\n");
-    struct PPM image;
-    image.width = WIDTH;
-    image.height = HEIGHT;
-    image.data = data;
-    exportPPM(args.outfile, &image);
+    printf("Iterating took %ld ms, colouring took %ld ms...\n", iterationTime, colorTime);
+    printf("Rendering took %ld ms...\n", iterationTime + colorTime);
 
     return 0;
 }
@@ -49,6 +49,20 @@ GtkWidget *lblMaxIterations;
 GtkWidget *hscMaxIterations;
 GtkObject *adjIterations;
 
+// precision chooser
+GtkWidget *lblPrecision;
+GtkWidget *cbDoubleDouble;
+
+// colour chooser
+GtkWidget *lblColors;
+GtkWidget *hscColorOffset;
+GtkObject *adjColorOffset;
+GtkWidget *bPalette;
+GtkWidget *bYUV;
+GtkWidget *cbHistogram;
+GtkWidget *vbColors;
+GtkWidget *hbPalette;
+
 // buttons
 GtkWidget *bReset;
 GtkWidget *bRender;
@@ -58,14 +72,22 @@ GtkWidget *hbButtons;
 pthread_t t;
 
 // functional values
-complex float upperLeft = INITIAL_UPPERLEFT;
-complex float lowerRight = INITIAL_LOWERRIGHT;
+// the view is kept as centre and span, the centre needs more digits than a double has for deep zooms
+deepfloat centerRe;
+deepfloat centerIm;
+double spanRe;
+double spanIm;
 int iLevel = 0;
-int iLevelMax = 16;
+int iLevelMax = 745; // perturbation theory ends at about 1e-300 per pixel, where the double offsets run out
+int iLevelDoubleDouble = 68; // double-double ends at about 1e-30 per pixel, perturbation theory takes over below
+gboolean doubleDouble = FALSE;
 int maxIterations = 100;
 gboolean rerender = FALSE;
 gboolean rendering = FALSE;
 
+float *field;          // iteration field of the current view, kept to colour it again without iterating
+int fieldIterations;   // the limit field was iterated with
+struct MandelbrotState state;  // where the pixels stopped, so a higher maxIterations continues them
 unsigned char *buffer;
 GdkPixbuf *image;
 
@@ -76,12 +98,20 @@ int setUpParameterChooser(int, char **);
 int setUpCChooser(int, char **);
 int setUpItChooser(int, char **);
 int setUpButtons(int, char **);
+int setUpPrecisionChooser(int, char **);
+int setUpColorChooser(int, char **);
+void resetView(void);
 void destroy(GtkWidget *, gpointer);
 gboolean delete_event(GtkWidget *, GdkEvent *, gpointer);
 GdkPixbuf * convertColorArray(unsigned char *);
 void bRender_clicked(GtkWidget *, gpointer);
 void bReset_clicked(GtkWidget *, gpointer);
 void evImageBox_clicked(GtkWidget *, GdkEventButton *, gpointer);
+void adjColorOffset_changed(GtkAdjustment *, gpointer);
+void bPalette_clicked(GtkWidget *, gpointer);
+void bYUV_clicked(GtkWidget *, gpointer);
+void cbHistogram_toggled(GtkWidget *, gpointer);
+void recolor(void);
 void GUIrender(void);
 void render(void);
 
@@ -103,7 +133,7 @@ setUpGUI(int argc, char *argv[])
     imgSet = gtk_image_new();
     gtk_widget_set_size_request(imgSet, WIDTH, HEIGHT);
     hLayout = gtk_hbox_new(FALSE, 10);
-    tblLayout = gtk_table_new(4, 2, FALSE);
+    tblLayout = gtk_table_new(6, 2, FALSE);
     gtk_table_set_row_spacings(GTK_TABLE(tblLayout), 40);
     vsLine = gtk_vseparator_new();
     evImageBox = gtk_event_box_new();
@@ -132,6 +162,8 @@ int
 setUpParameterChooser(int argc, char *argv[])
 {
     setUpItChooser(argc, argv);
+    setUpPrecisionChooser(argc, argv);
+    setUpColorChooser(argc, argv);
     setUpButtons(argc, argv);
 
     lblTime = gtk_label_new("Computation time:");
@@ -139,13 +171,17 @@ setUpParameterChooser(int argc, char *argv[])
 
     gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(lblMaxIterations), 0, 1, 0, 1, GTK_SHRINK, GTK_SHRINK, 0, 0);
     gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(hscMaxIterations), 1, 2, 0, 1, GTK_FILL, GTK_SHRINK, 0, 0);
-    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(lblTime), 0, 1, 1, 2, GTK_SHRINK, GTK_SHRINK, 0, 0);
-    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(lblTiming), 1, 2, 1, 2, GTK_SHRINK, GTK_SHRINK, 0, 0);
-    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(hbButtons), 1, 2, 2, 3, GTK_SHRINK, GTK_SHRINK, 0, 0);
+    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(lblPrecision), 0, 1, 1, 2, GTK_SHRINK, GTK_SHRINK, 0, 0);
+    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(cbDoubleDouble), 1, 2, 1, 2, GTK_FILL, GTK_SHRINK, 0, 0);
+    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(lblTime), 0, 1, 2, 3, GTK_SHRINK, GTK_SHRINK, 0, 0);
+    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(lblTiming), 1, 2, 2, 3, GTK_SHRINK, GTK_SHRINK, 0, 0);
+    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(lblColors), 0, 1, 3, 4, GTK_SHRINK, GTK_SHRINK, 0, 0);
+    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(vbColors), 1, 2, 3, 4, GTK_FILL, GTK_SHRINK, 0, 0);
+    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(hbButtons), 1, 2, 4, 5, GTK_SHRINK, GTK_SHRINK, 0, 0);
 
     aSpacer = gtk_alignment_new(0, 0, 1, 1);
-    gtk_widget_set_size_request(aSpacer, 10, 500);
-    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(aSpacer), 0, 2, 3, 4, GTK_SHRINK, GTK_EXPAND, 0, 0);
+    gtk_widget_set_size_request(aSpacer, 10, 320);
+    gtk_table_attach(GTK_TABLE(tblLayout), GTK_WIDGET(aSpacer), 0, 2, 5, 6, GTK_SHRINK, GTK_EXPAND, 0, 0);
 
     return 1;
 }
@@ -164,6 +200,48 @@ setUpItChooser(int argc, char *argv[])
     return 1;
 }
 
+int
+setUpPrecisionChooser(int argc, char *argv[])
+{
+    lblPrecision = gtk_label_new("Precision:");
+    cbDoubleDouble = gtk_check_button_new_with_label("double-double");
+
+    return 1;
+}
+
+int
+setUpColorChooser(int argc, char *argv[])
+{
+    lblColors = gtk_label_new("Colours:");
+
+    // the colours only need the kept field, so they change without iterating
+    adjColorOffset = gtk_adjustment_new(0, 0, 1, 0.01, 0.1, 0);
+    hscColorOffset = gtk_hscale_new(GTK_ADJUSTMENT(adjColorOffset));
+    gtk_widget_set_size_request(hscColorOffset, 100, 30);
+    gtk_scale_set_digits(GTK_SCALE(hscColorOffset), 2);
+    gtk_scale_set_value_pos(GTK_SCALE(hscColorOffset), GTK_POS_RIGHT);
+    g_signal_connect(G_OBJECT(adjColorOffset), "value_changed", G_CALLBACK(adjColorOffset_changed), NULL);
+
+    bPalette = gtk_button_new_with_label("Palette...");
+    bYUV = gtk_button_new_with_label("YUV");
+    g_signal_connect(G_OBJECT(bPalette), "clicked", G_CALLBACK(bPalette_clicked), NULL);
+    g_signal_connect(G_OBJECT(bYUV), "clicked", G_CALLBACK(bYUV_clicked), NULL);
+
+    cbHistogram = gtk_check_button_new_with_label("histogram equalisation");
+    g_signal_connect(G_OBJECT(cbHistogram), "toggled", G_CALLBACK(cbHistogram_toggled), NULL);
+
+    hbPalette = gtk_hbutton_box_new();
+    gtk_box_pack_start(GTK_BOX(hbPalette), bYUV, FALSE, FALSE, 5);
+    gtk_box_pack_start(GTK_BOX(hbPalette), bPalette, FALSE, FALSE, 5);
+
+    vbColors = gtk_vbox_new(FALSE, 5);
+    gtk_box_pack_start(GTK_BOX(vbColors), hscColorOffset, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vbColors), cbHistogram, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vbColors), hbPalette, FALSE, FALSE, 0);
+
+    return 1;
+}
+
 int 
 setUpButtons(int argc, char *argv[]) 
 {
@@ -223,31 +301,102 @@ bRender_clicked(GtkWidget * widget, gpointer data)
 void 
 bReset_clicked(GtkWidget * widget, gpointer data)
 {
-    upperLeft = -2.5 + 1.5*I;
-    lowerRight = 1 - 1.5*I;
-    iLevel = 0;
+    resetView();
     GUIrender();
 }
 
+void
+resetView(void)
+{
+    centerRe = deepFromDouble((creal(INITIAL_UPPERLEFT) + creal(INITIAL_LOWERRIGHT)) / 2);
+    centerIm = deepFromDouble((cimag(INITIAL_UPPERLEFT) + cimag(INITIAL_LOWERRIGHT)) / 2);
+    spanRe = creal(INITIAL_LOWERRIGHT) - creal(INITIAL_UPPERLEFT);
+    spanIm = cimag(INITIAL_UPPERLEFT) - cimag(INITIAL_LOWERRIGHT);
+    iLevel = 0;
+}
+
 void 
 evImageBox_clicked(GtkWidget * widget, GdkEventButton *event, gpointer data)
 {
-    if(rerender && !rendering) {
+    if(rerender && !rendering && iLevel < iLevelMax) {
         maxIterations = (int) gtk_range_get_value(GTK_RANGE(hscMaxIterations));
         
-        float spanX = crealf(lowerRight) - crealf(upperLeft);
-        float spanY = cimagf(upperLeft) - cimagf(lowerRight);
-
-        float centerX = crealf(upperLeft) + event->x/WIDTH * spanX;
-        float centerY = cimagf(lowerRight) + (HEIGHT - event->y)/HEIGHT * spanY;
+        // the offset of the click to the centre is small, only the sum needs the extra digits
+        deepfloat offsetRe = deepFromDouble((event->x/WIDTH - 0.5) * spanRe);
+        deepfloat offsetIm = deepFromDouble((0.5 - event->y/HEIGHT) * spanIm);
+        deepAdd(&centerRe, &centerRe, &offsetRe, DEEP_LIMBS);
+        deepAdd(&centerIm, &centerIm, &offsetIm, DEEP_LIMBS);
 
-        upperLeft = (centerX - ZOOM/2 * spanX) + (centerY + ZOOM/2 * spanY) * I;
-        lowerRight = (centerX + ZOOM/2 * spanX) + (centerY - ZOOM/2 * spanY) * I;
+        spanRe *= ZOOM;
+        spanIm *= ZOOM;
+        iLevel++;
 
         GUIrender();
     }
 }
 
+void
+adjColorOffset_changed(GtkAdjustment *adjustment, gpointer data)
+{
+    setMandelbrotColorOffset((float) gtk_adjustment_get_value(adjustment));
+    recolor();
+}
+
+void
+bPalette_clicked(GtkWidget *widget, gpointer data)
+{
+    GtkWidget *dialog = gtk_file_chooser_dialog_new("Load palette", GTK_WINDOW(winMain), GTK_FILE_CHOOSER_ACTION_OPEN,
+                                                    GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+                                                    GTK_STOCK_OPEN, GTK_RESPONSE_ACCEPT, NULL);
+
+    if(gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        char *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        if(loadMandelbrotPalette(filename) == 0) {
+            recolor();
+        } else {
+            gtk_label_set_text(GTK_LABEL(lblTiming), "invalid palette");
+        }
+        g_free(filename);
+    }
+    gtk_widget_destroy(dialog);
+}
+
+void
+bYUV_clicked(GtkWidget *widget, gpointer data)
+{
+    loadMandelbrotPalette(NULL);
+    recolor();
+}
+
+void
+cbHistogram_toggled(GtkWidget *widget, gpointer data)
+{
+    setMandelbrotEqualization(gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)));
+    recolor();
+}
+
+void
+recolor(void)
+{
+    // while rendering the field is about to be replaced, the new one gets the new colours anyway
+    if(!rerender || rendering) {
+        return;
+    }
+
+    gettimeofday(&start, NULL);
+    free(buffer);
+    buffer = colorizeMandelbrot(field, fieldIterations, WIDTH, HEIGHT);
+    GdkPixbuf *colored = convertColorArray(buffer);
+    gettimeofday(&stop, NULL);
+
+    gtk_image_set_from_pixbuf(GTK_IMAGE(imgSet), colored);
+    g_object_unref(G_OBJECT(image));
+    image = colored;
+
+    long colorTime = (stop.tv_sec-start.tv_sec)*1000 + (stop.tv_usec-start.tv_usec)/1000;
+    gtk_label_set_text(GTK_LABEL(lblTiming), g_strdup_printf("%ld ms (colours only)", colorTime));
+}
+
 void
 GUIrender(void)
 {
@@ -257,8 +406,14 @@ GUIrender(void)
         gtk_widget_set_sensitive(GTK_WIDGET(bRender), FALSE);
         gtk_widget_set_sensitive(GTK_WIDGET(bReset), FALSE);
         gtk_widget_set_sensitive(GTK_WIDGET(hscMaxIterations), FALSE);
+        gtk_widget_set_sensitive(GTK_WIDGET(cbDoubleDouble), FALSE);
+        doubleDouble = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(cbDoubleDouble));
     
         if(rerender) {
+            // a field from the resumable path belongs to state and is continued there
+            if(field != state.iterations) {
+                free(field);
+            }
             free(buffer);
             gtk_image_clear(GTK_IMAGE(imgSet));
             g_object_unref(G_OBJECT(image));
@@ -280,8 +435,19 @@ render(void)
 	gdk_threads_enter();
 	#endif
 	
+    complex double upperLeft = (deepToDouble(&centerRe) - spanRe/2) + (deepToDouble(&centerIm) + spanIm/2) * I;
+    complex double lowerRight = (deepToDouble(&centerRe) + spanRe/2) + (deepToDouble(&centerIm) - spanIm/2) * I;
+
     gettimeofday(&start, NULL);
-    buffer = generateMandelbrot(upperLeft, lowerRight, maxIterations, WIDTH, HEIGHT);
+    if(doubleDouble && iLevel <= iLevelDoubleDouble) {
+        field = iterateMandelbrotDoubleDouble(centerRe, centerIm, spanRe, spanIm, maxIterations, WIDTH, HEIGHT);
+    } else if(needsPerturbation(upperLeft, lowerRight, WIDTH, HEIGHT)) {
+        field = iterateMandelbrotPerturbation(centerRe, centerIm, spanRe, spanIm, maxIterations, WIDTH, HEIGHT);
+    } else {
+        field = iterateMandelbrotResumable(&state, upperLeft, lowerRight, maxIterations, WIDTH, HEIGHT);
+    }
+    fieldIterations = maxIterations;
+    buffer = colorizeMandelbrot(field, fieldIterations, WIDTH, HEIGHT);
     image = convertColorArray(buffer);
     gettimeofday(&stop, NULL);
     gtk_image_set_from_pixbuf(GTK_IMAGE(imgSet), image);
@@ -290,6 +456,7 @@ render(void)
     gtk_widget_set_sensitive(GTK_WIDGET(bRender), TRUE);
     gtk_widget_set_sensitive(GTK_WIDGET(bReset), TRUE);
     gtk_widget_set_sensitive(GTK_WIDGET(hscMaxIterations), TRUE);
+    gtk_widget_set_sensitive(GTK_WIDGET(cbDoubleDouble), TRUE);
 
     long renderTime = (stop.tv_sec-start.tv_sec)*1000 + (stop.tv_usec-start.tv_usec)/1000;
     gtk_label_set_text(GTK_LABEL(lblTiming), g_strdup_printf("%ld ms", renderTime));
@@ -305,6 +472,7 @@ int
 main(int argc, char *argv[]) 
 {
     gtk_init(&argc, &argv);
+    resetView();
     int iError = setUpGUI(argc, argv);
     gtk_main();
     return iError;
@@ -0,0 +1,122 @@
+/*   Copyright (C) 2013 Daniel Thürck
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+#include "costmap.h"
+
+/*
+ * Schlägt die Kostendichte an einem Punkt der komplexen Ebene nach
+ *
+ * Arguments:
+ *  map - Die Kostenkarte
+ *  re, im - Der Punkt
+ *
+ * Returns:
+ *  Sekunden pro Pixel am Punkt, außerhalb des gemessenen Ausschnitts der Mittelwert
+ */
+static double
+densityAt(const struct CostMap *map, double re, double im)
+{
+	double u = (re - creal(map->upperLeft)) / (creal(map->lowerRight) - creal(map->upperLeft));
+	double v = (cimag(map->upperLeft) - im) / (cimag(map->upperLeft) - cimag(map->lowerRight));
+
+	if (!(u >= 0 && u < 1 && v >= 0 && v < 1))
+		return map->meanDensity;
+
+	return map->density[(int)(v * COST_MAP_HEIGHT)][(int)(u * COST_MAP_WIDTH)];
+}
+
+double
+estimateTileCost(
+    const struct CostMap *map,
+    complex double upperLeft,
+    complex double lowerRight,
+    int width,
+    int height,
+    const struct Tile *tile)
+{
+    double stepRe = (creal(lowerRight) - creal(upperLeft)) / width;
+    double stepIm = (cimag(upperLeft) - cimag(lowerRight)) / height;
+
+    // Mitte und die Mitten der vier Viertel der Kachel
+    static const double samples[5][2] = {
+        {0.5, 0.5}, {0.25, 0.25}, {0.75, 0.25}, {0.25, 0.75}, {0.75, 0.75}
+    };
+
+    double density = 0;
+    for(int s = 0; s < 5; s++) {
+        double re = creal(upperLeft) + (tile->x + samples[s][0] * tile->width) * stepRe;
+        double im = cimag(upperLeft) - (tile->y + samples[s][1] * tile->height) * stepIm;
+        density += densityAt(map, re, im);
+    }
+
+    return density / 5 * tile->width * tile->height;
+}
+
+void
+recordTileCosts(
+    struct CostMap *map,
+    complex double upperLeft,
+    complex double lowerRight,
+    int width,
+    int height,
+    const struct Tile *tiles,
+    const double *durations,
+    int count)
+{
+    // Gewichtete Summe der Dichten und überdeckte Fläche je Zelle
+    double cost[COST_MAP_HEIGHT][COST_MAP_WIDTH] = {{0}};
+    double area[COST_MAP_HEIGHT][COST_MAP_WIDTH] = {{0}};
+    double total = 0;
+
+    for(int t = 0; t < count; t++) {
+        const struct Tile *tile = &tiles[t];
+        double density = durations[t] / ((double)tile->width * tile->height);
+        total += durations[t];
+
+        // Zellen, die die Kachel berührt; Zelle (cx, cy) umfasst die Pixel [cx*width/W, (cx+1)*width/W)
+        int cx0 = (long)tile->x * COST_MAP_WIDTH / width;
+        int cx1 = ((long)(tile->x + tile->width) * COST_MAP_WIDTH - 1) / width;
+        int cy0 = (long)tile->y * COST_MAP_HEIGHT / height;
+        int cy1 = ((long)(tile->y + tile->height) * COST_MAP_HEIGHT - 1) / height;
+
+        for(int cy = cy0; cy <= cy1 && cy < COST_MAP_HEIGHT; cy++) {
+            double top = (double)cy * height / COST_MAP_HEIGHT;
+            double bottom = (double)(cy + 1) * height / COST_MAP_HEIGHT;
+            double overlapY = (bottom < tile->y + tile->height ? bottom : tile->y + tile->height)
+                            - (top > tile->y ? top : tile->y);
+
+            for(int cx = cx0; cx <= cx1 && cx < COST_MAP_WIDTH; cx++) {
+                double left = (double)cx * width / COST_MAP_WIDTH;
+                double right = (double)(cx + 1) * width / COST_MAP_WIDTH;
+                double overlapX = (right < tile->x + tile->width ? right : tile->x + tile->width)
+                                - (left > tile->x ? left : tile->x);
+
+                if(overlapX > 0 && overlapY > 0) {
+                    cost[cy][cx] += density * overlapX * overlapY;
+                    area[cy][cx] += overlapX * overlapY;
+                }
+            }
+        }
+    }
+
+    map->meanDensity = total / ((double)width * height);
+    for(int cy = 0; cy < COST_MAP_HEIGHT; cy++) {
+        for(int cx = 0; cx < COST_MAP_WIDTH; cx++) {
+            map->density[cy][cx] = area[cy][cx] > 0 ? cost[cy][cx] / area[cy][cx] : map->meanDensity;
+        }
+    }
+
+    map->upperLeft = upperLeft;
+    map->lowerRight = lowerRight;
+    map->valid = 1;
+}
@@ -0,0 +1,82 @@
+/*   Copyright (C) 2013 Daniel Thürck
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+#ifndef COSTMAP_HEADER
+#define COSTMAP_HEADER
+
+#include <complex.h>
+
+#include "scheduler.h"
+
+// Auflösung der Kostenkarte, unabhängig von der Bildgröße
+#define COST_MAP_WIDTH 32
+#define COST_MAP_HEIGHT 24
+
+/*
+ * Coarse map of how long the pixels of the previous frame took to iterate,
+ * used to predict the cost of the tiles of the next frame. The map is kept
+ * in the coordinates of the frame it was measured on, so it stays useful
+ * after the view has been moved or zoomed.
+ */
+struct CostMap {
+	int valid;                 // 0 solange noch kein Bild gemessen wurde
+	complex double upperLeft;  // Ausschnitt des gemessenen Bildes
+	complex double lowerRight;
+	double density[COST_MAP_HEIGHT][COST_MAP_WIDTH];  // Sekunden pro Pixel
+	double meanDensity;        // für Punkte außerhalb des gemessenen Ausschnitts
+};
+
+/*
+ * Predicts the cost of a tile of a view from the map by sampling the map at
+ * a few points of the tile.
+ *
+ * Arguments:
+ *	map - A valid cost map
+ *	upperLeft, lowerRight, width, height - The view the tile belongs to
+ *	tile - The tile
+ *
+ * Returns:
+ *	The expected time in seconds
+ */
+double
+estimateTileCost(
+    const struct CostMap *map,
+    complex double upperLeft,
+    complex double lowerRight,
+    int width,
+    int height,
+    const struct Tile *tile);
+
+/*
+ * Replaces the map by the measured durations of the tiles of a view. The
+ * tiles have to cover the view.
+ *
+ * Arguments:
+ *	map - The cost map
+ *	upperLeft, lowerRight, width, height - The view that was iterated
+ *	tiles - The tiles of the view
+ *	durations - Time in seconds every tile took
+ *	count - Number of tiles
+ */
+void
+recordTileCosts(
+    struct CostMap *map,
+    complex double upperLeft,
+    complex double lowerRight,
+    int width,
+    int height,
+    const struct Tile *tiles,
+    const double *durations,
+    int count);
+
+#endif /* COSTMAP_HEADER */
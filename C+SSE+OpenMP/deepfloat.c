@@ -0,0 +1,338 @@
+/*
+ *   Copyright (C) 2013 Daniel Thürck
+ *   Copyright (C) 2013 Stefan Schmidt
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+
+/*
+ * Festkommazahlen beliebiger Genauigkeit für die Koordinaten tiefer Zooms: Betrag
+ * in 64-Bit-Wörtern (das erste ist der ganzzahlige Teil) und ein Vorzeichen.
+ * Gerechnet wird nur mit so vielen Wörtern, wie die Vergrößerung verlangt, die
+ * Referenzfolge der Störungsrechnung kostet also nur bei tiefen Zooms mehr.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "deepfloat.h"
+
+// Bits über die Pixelgröße hinaus, damit die Rundungsfehler langer Referenzfolgen unter einem Pixel bleiben
+#define GUARD_BITS 64
+
+// Dezimalstellen, die ein deepfloat höchstens auflöst (1216 Bit sind etwa 366 Stellen)
+#define DEEP_DIGITS 400
+
+/*
+ * Vergleicht die Beträge zweier Zahlen
+ *
+ * Returns:
+ *  -1, 0 oder 1 wenn |a| kleiner, gleich oder größer als |b| ist
+ */
+static int
+compareMagnitude(const deepfloat *a, const deepfloat *b, int limbs)
+{
+	for (int k = 0; k < limbs; k++)
+		if (a->limb[k] != b->limb[k])
+			return a->limb[k] < b->limb[k] ? -1 : 1;
+
+	return 0;
+}
+
+/*
+ * Addiert die Beträge zweier Zahlen, vom letzten Wort her mit Übertrag
+ */
+static void
+addMagnitude(deepfloat *result, const deepfloat *a, const deepfloat *b, int limbs)
+{
+	uint64_t carry = 0;
+	for (int k = limbs - 1; k >= 0; k--)
+	{
+		uint64_t sum = a->limb[k] + carry;
+		carry = sum < carry;
+		result->limb[k] = sum + b->limb[k];
+		carry += result->limb[k] < sum;
+	}
+}
+
+/*
+ * Zieht den Betrag von b von dem (nicht kleineren) Betrag von a ab
+ */
+static void
+subMagnitude(deepfloat *result, const deepfloat *a, const deepfloat *b, int limbs)
+{
+	uint64_t borrow = 0;
+	for (int k = limbs - 1; k >= 0; k--)
+	{
+		uint64_t ak = a->limb[k];
+		uint64_t bk = b->limb[k];
+		result->limb[k] = ak - bk - borrow;
+		borrow = ak < bk || (ak == bk && borrow);
+	}
+}
+
+/*
+ * Addiert a und b mit dem Vorzeichen negativeB (für die Subtraktion umgedreht)
+ */
+static void
+addSigned(deepfloat *result, const deepfloat *a, const deepfloat *b, int negativeB, int limbs)
+{
+	// Die Vorzeichen vorher lesen, result darf a oder b sein
+	int negativeA = a->negative;
+
+	if (negativeA == negativeB)
+	{
+		addMagnitude(result, a, b, limbs);
+		result->negative = negativeA;
+	}
+	else if (compareMagnitude(a, b, limbs) >= 0)
+	{
+		subMagnitude(result, a, b, limbs);
+		result->negative = negativeA;
+	}
+	else
+	{
+		subMagnitude(result, b, a, limbs);
+		result->negative = negativeB;
+	}
+
+	memset(result->limb + limbs, 0, (DEEP_LIMBS - limbs) * sizeof(uint64_t));
+}
+
+/*
+ * Multipliziert zwei Wörter zu einem doppelt so breiten Produkt
+ *
+ * Arguments:
+ *  a, b - Die Faktoren
+ *  high - Erhält das obere Wort des Produkts
+ *
+ * Returns:
+ *  Das untere Wort des Produkts
+ */
+static inline uint64_t
+multiplyWide(uint64_t a, uint64_t b, uint64_t *high)
+{
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 product = (unsigned __int128)a * b;
+	*high = (uint64_t)(product >> 64);
+	return (uint64_t)product;
+#else
+	// 32-Bit-Zielen fehlt ein 128-Bit-Typ, das Produkt entsteht dann aus vier Teilprodukten der Hälften
+	uint64_t aLow = (uint32_t)a;
+	uint64_t aHigh = a >> 32;
+	uint64_t bLow = (uint32_t)b;
+	uint64_t bHigh = b >> 32;
+
+	uint64_t lowLow = aLow * bLow;
+	uint64_t lowHigh = aLow * bHigh;
+	uint64_t highLow = aHigh * bLow;
+	uint64_t highHigh = aHigh * bHigh;
+
+	// Die mittleren Teilprodukte samt Übertrag aus dem unteren Teil, die Summe passt in 64 Bit
+	uint64_t middle = (lowLow >> 32) + (uint32_t)lowHigh + (uint32_t)highLow;
+	*high = highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+	return (middle << 32) | (uint32_t)lowLow;
+#endif
+}
+
+/*
+ * Teilt den Betrag durch eine kleine Zahl (schriftlich, vom ersten Wort her)
+ *
+ * Arguments:
+ *  divisor - Passt in 32 Bit, damit Rest und halbes Wort zusammen in 64 Bit passen
+ */
+static void
+divideSmall(deepfloat *x, uint32_t divisor)
+{
+	uint64_t rest = 0;
+	for (int k = 0; k < DEEP_LIMBS; k++)
+	{
+		// In halben Wörtern, so reicht 64-Bit-Arithmetik
+		uint64_t upper = rest << 32 | x->limb[k] >> 32;
+		rest = upper % divisor;
+		uint64_t lower = rest << 32 | (uint32_t)x->limb[k];
+		rest = lower % divisor;
+		x->limb[k] = (upper / divisor) << 32 | lower / divisor;
+	}
+}
+
+/*
+ * Liest eine Ziffer der Folge aus Vor- und Nachkommastellen
+ *
+ * Arguments:
+ *  integerDigits, integerCount - Die Stellen vor dem Komma
+ *  fractionDigits, digitCount - Die Stellen nach dem Komma und die Anzahl aller Stellen
+ *  k - Nummer der Ziffer, vor und hinter der Folge stehen Nullen
+ */
+static int
+digitAt(const char *integerDigits, int integerCount, const char *fractionDigits, int digitCount, long k)
+{
+	if (k < 0 || k >= digitCount)
+		return 0;
+
+	return (k < integerCount ? integerDigits[k] : fractionDigits[k - integerCount]) - '0';
+}
+
+deepfloat
+parseDeepFloat(const char *text)
+{
+    deepfloat x;
+    memset(&x, 0, sizeof(x));
+
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    int negative = 0;
+    if (*text == '-' || *text == '+') {
+        negative = *text == '-';
+        text++;
+    }
+
+    // Die Ziffern vor und nach dem Komma merken, der Exponent verschiebt nur das Komma
+    const char *integerDigits = text;
+    int integerCount = 0;
+    for (; isdigit((unsigned char)*text); text++) {
+        integerCount++;
+    }
+    const char *fractionDigits = text;
+    int fractionCount = 0;
+    if (*text == '.') {
+        fractionDigits = ++text;
+        for (; isdigit((unsigned char)*text); text++) {
+            fractionCount++;
+        }
+    }
+    long point = integerCount;
+    if (*text == 'e' || *text == 'E') {
+        point += atol(text + 1);
+    }
+
+    int digitCount = integerCount + fractionCount;
+
+    // Nachkommastellen von hinten: x = (x + Ziffer) / 10, Stellen jenseits der Genauigkeit fallen weg
+    long last = digitCount - 1 < point + DEEP_DIGITS ? digitCount - 1 : point + DEEP_DIGITS;
+    for (long k = last; k >= point; k--) {
+        x.limb[0] = digitAt(integerDigits, integerCount, fractionDigits, digitCount, k);
+        divideSmall(&x, 10);
+    }
+
+    // Der ganzzahlige Teil passt für sinnvolle Koordinaten in ein Wort
+    uint64_t integer = 0;
+    for (long k = 0; k < point && k < digitCount; k++) {
+        integer = integer * 10 + digitAt(integerDigits, integerCount, fractionDigits, digitCount, k);
+    }
+    for (long k = digitCount; k < point; k++) {
+        integer *= 10;
+    }
+
+    x.limb[0] = integer;
+    x.negative = negative;
+    return x;
+}
+
+deepfloat
+deepFromDouble(double value)
+{
+    deepfloat x;
+    memset(&x, 0, sizeof(x));
+    x.negative = value < 0;
+
+    // Wort für Wort abschneiden und den Rest um 64 Bit hochschieben, beides ist exakt
+    double rest = fabs(value);
+    for (int k = 0; k < DEEP_LIMBS && rest != 0; k++) {
+        double whole = floor(rest);
+        x.limb[k] = (uint64_t)whole;
+        rest = ldexp(rest - whole, 64);
+    }
+
+    return x;
+}
+
+double
+deepToDouble(const deepfloat *x)
+{
+    // Die ersten drei Wörter ab dem ersten von null verschiedenen reichen für 53 Bit, die kleinsten zuerst addieren
+    int first = 0;
+    while (first < DEEP_LIMBS && x->limb[first] == 0) {
+        first++;
+    }
+    int last = first + 2 < DEEP_LIMBS ? first + 2 : DEEP_LIMBS - 1;
+
+    double value = 0;
+    for (int k = last; k >= first; k--) {
+        value += ldexp((double)x->limb[k], -64 * k);
+    }
+
+    return x->negative ? -value : value;
+}
+
+int
+deepLimbs(double resolution)
+{
+    if (!(resolution > 0)) {
+        return DEEP_LIMBS;
+    }
+
+    // Ein Wort für den ganzzahligen Teil, dazu die Bits bis zur Auflösung und GUARD_BITS
+    int bits = (int)ceil(-log2(resolution)) + GUARD_BITS;
+    int limbs = 1 + (bits + 63) / 64;
+
+    return limbs < 2 ? 2 : limbs > DEEP_LIMBS ? DEEP_LIMBS : limbs;
+}
+
+void
+deepAdd(deepfloat *result, const deepfloat *a, const deepfloat *b, int limbs)
+{
+    addSigned(result, a, b, b->negative, limbs);
+}
+
+void
+deepSub(deepfloat *result, const deepfloat *a, const deepfloat *b, int limbs)
+{
+    addSigned(result, a, b, !b->negative, limbs);
+}
+
+void
+deepMul(deepfloat *result, const deepfloat *a, const deepfloat *b, int limbs)
+{
+    // Als ganze Zahlen A, B mit limbs Wörtern ist das Ergebnis (A * B) >> 64 * (limbs - 1),
+    // das volle Produkt entsteht in product (niedrigstes Wort zuerst) nach der Schulmethode
+    uint64_t product[2 * DEEP_LIMBS];
+    memset(product, 0, 2 * limbs * sizeof(uint64_t));
+
+    for (int i = 0; i < limbs; i++) {
+        uint64_t ai = a->limb[limbs - 1 - i];
+        if (ai == 0) {
+            continue;
+        }
+        uint64_t carry = 0;
+        for (int j = 0; j < limbs; j++) {
+            // ai * b_j + product + carry ist höchstens (2^64 - 1)^2 + 2 (2^64 - 1) = 2^128 - 1
+            uint64_t high;
+            uint64_t low = multiplyWide(ai, b->limb[limbs - 1 - j], &high);
+            low += product[i + j];
+            high += low < product[i + j];
+            low += carry;
+            high += low < carry;
+            product[i + j] = low;
+            carry = high;
+        }
+        product[i + limbs] = carry;
+    }
+
+    result->negative = a->negative != b->negative;
+    for (int k = 0; k < limbs; k++) {
+        result->limb[k] = product[2 * limbs - 2 - k];
+    }
+    memset(result->limb + limbs, 0, (DEEP_LIMBS - limbs) * sizeof(uint64_t));
+}
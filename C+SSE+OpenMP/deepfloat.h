@@ -0,0 +1,81 @@
+/*
+ *   Copyright (C) 2013 Daniel Thürck
+ *   Copyright (C) 2013 Stefan Schmidt
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+#ifndef DEEPFLOAT_HEADER
+#define DEEPFLOAT_HEADER
+
+#include <stdint.h>
+
+/*
+ * Number of 64-bit words of a deepfloat: one for the integer part and 1216
+ * bits after the binary point, more than the smallest double (about 1e-308)
+ * perturbation theory can iterate the offsets of the pixels in.
+ */
+#define DEEP_LIMBS 20
+
+/*
+ * Real fixed-point number with up to DEEP_LIMBS * 64 bits, used for the
+ * coordinates of deep zooms where double can no longer tell the pixels apart.
+ * The arithmetic only uses as many words as it is asked to (see deepLimbs),
+ * so its cost grows with the zoom; the words beyond are kept zero.
+ */
+typedef struct {
+	int negative;
+	uint64_t limb[DEEP_LIMBS];  // magnitude, limb[0] is the integer part, limb[k] is worth 2^(-64k)
+} deepfloat;
+
+/*
+ * Parses a decimal number (e.g. "-0.743643887037158704752191506114774e0")
+ * with all the precision a deepfloat offers.
+ */
+deepfloat
+parseDeepFloat(const char *text);
+
+/*
+ * Converts a double exactly.
+ */
+deepfloat
+deepFromDouble(double value);
+
+/*
+ * Rounds to the nearest double (up to the last bit or so).
+ */
+double
+deepToDouble(const deepfloat *x);
+
+/*
+ * Returns the number of words the coordinates need to tell points resolution
+ * apart, with some bits to spare for the rounding errors of long iterations.
+ *
+ * Arguments:
+ *	resolution - Distance of two neighbouring pixels in the complex plane
+ */
+int
+deepLimbs(double resolution);
+
+/*
+ * Computes result = a + b, a - b or a * b on the first limbs words, the
+ * result may be one of the operands. The integer part must stay below 2^64.
+ */
+void
+deepAdd(deepfloat *result, const deepfloat *a, const deepfloat *b, int limbs);
+
+void
+deepSub(deepfloat *result, const deepfloat *a, const deepfloat *b, int limbs);
+
+void
+deepMul(deepfloat *result, const deepfloat *a, const deepfloat *b, int limbs);
+
+#endif /* DEEPFLOAT_HEADER */
@@ -0,0 +1,112 @@
+/*
+ *   Copyright (C) 2013 Daniel Thürck
+ *   Copyright (C) 2013 Stefan Schmidt
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "kernel.h"
+
+static const struct KernelSet kernelsSSE = {
+	"SSE",
+	escapeRowFloat_sse,
+	escapeRowDouble_sse,
+	escapeRunFloat_sse,
+	escapeRunDouble_sse,
+	formulaRunFloat_sse,
+	formulaRunDouble_sse,
+	resumeRunFloat_sse,
+	resumeRunDouble_sse,
+	escapePointsFloat_sse,
+	escapePointsDouble_sse,
+	estimatePointsFloat_sse,
+	estimatePointsDouble_sse,
+	escapeRowDoubleDouble_sse,
+	perturbPointsDouble_sse
+};
+
+static const struct KernelSet kernelsAVX2 = {
+	"AVX2",
+	escapeRowFloat_avx2,
+	escapeRowDouble_avx2,
+	escapeRunFloat_avx2,
+	escapeRunDouble_avx2,
+	formulaRunFloat_avx2,
+	formulaRunDouble_avx2,
+	resumeRunFloat_avx2,
+	resumeRunDouble_avx2,
+	escapePointsFloat_avx2,
+	escapePointsDouble_avx2,
+	estimatePointsFloat_avx2,
+	estimatePointsDouble_avx2,
+	escapeRowDoubleDouble_avx2,
+	perturbPointsDouble_avx2
+};
+
+static const struct KernelSet kernelsAVX512 = {
+	"AVX-512",
+	escapeRowFloat_avx512,
+	escapeRowDouble_avx512,
+	escapeRunFloat_avx512,
+	escapeRunDouble_avx512,
+	formulaRunFloat_avx512,
+	formulaRunDouble_avx512,
+	resumeRunFloat_avx512,
+	resumeRunDouble_avx512,
+	escapePointsFloat_avx512,
+	escapePointsDouble_avx512,
+	estimatePointsFloat_avx512,
+	estimatePointsDouble_avx512,
+	escapeRowDoubleDouble_avx512,
+	perturbPointsDouble_avx512
+};
+
+static const struct KernelSet *kernels = NULL;
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+
+/*
+ * Wählt die Kernel genau einmal aus, pthread_once macht das sicher für Aufrufe
+ * aus mehreren Threads (z.B. innerhalb paralleler OpenMP-Bereiche).
+ */
+static void
+initKernels(void)
+{
+	__builtin_cpu_init();
+	const char *isa = getenv("MANDELBROT_ISA");
+
+	if (isa != NULL && strcmp(isa, "sse") != 0 && strcmp(isa, "avx2") != 0 && strcmp(isa, "avx512") != 0) {
+		printf("Unknown instruction set MANDELBROT_ISA=%s (expected sse, avx2 or avx512), ignoring it...\n", isa);
+		isa = NULL;
+	}
+
+	int allowAVX512 = isa == NULL || strcmp(isa, "avx512") == 0;
+	int allowAVX2 = allowAVX512 || strcmp(isa, "avx2") == 0;
+
+	if (allowAVX512 && __builtin_cpu_supports("avx512f")) {
+		kernels = &kernelsAVX512;
+	} else if (allowAVX2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		kernels = &kernelsAVX2;
+	} else {
+		kernels = &kernelsSSE;
+	}
+}
+
+const struct KernelSet *
+selectKernels(void)
+{
+	pthread_once(&kernelsOnce, initKernels);
+	return kernels;
+}
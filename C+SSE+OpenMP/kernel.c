@@ -0,0 +1,1107 @@
+/*
+ *   Copyright (C) 2013 Daniel Thürck
+ *   Copyright (C) 2013 Stefan Schmidt
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+
+/*
+ * Diese Datei wird für jeden Befehlssatz und jede Genauigkeit einmal übersetzt
+ * (siehe Makefile). Die Vektorbreite ergibt sich aus den Compiler-Flags, mit
+ * KERNEL_DOUBLE wird in double statt float gerechnet. Die exportierten Funktionen
+ * bekommen Genauigkeit und Befehlssatz als Suffix, z.B. escapeRowDouble_avx2.
+ */
+#include <math.h>
+#include <stddef.h>
+#include <immintrin.h>
+
+#include "globals.h"
+#include "kernel.h"
+
+#if defined(__AVX512F__)
+	#define VECTOR_BYTES 64
+	#define ISA avx512
+#elif defined(__AVX2__)
+	#define VECTOR_BYTES 32
+	#define ISA avx2
+#else
+	#define VECTOR_BYTES 16
+	#define ISA sse
+#endif
+
+#ifdef KERNEL_DOUBLE
+	typedef double real;
+	typedef long long integer;
+	#define PRECISION Double
+#else
+	typedef float real;
+	typedef int integer;
+	#define PRECISION Float
+#endif
+
+#define KERNEL_NAME2(name, precision, isa) name##precision##_##isa
+#define KERNEL_NAME(name, precision, isa) KERNEL_NAME2(name, precision, isa)
+#define KERNEL(name) KERNEL_NAME(name, PRECISION, ISA)
+
+#define VLEN (VECTOR_BYTES / (int)sizeof(real))
+
+// Realteile und Imaginärteile liegen in getrennten Registern (structure of arrays).
+// Masken und Iterationszähler haben die gleiche Breite pro Lane wie die Zahlen.
+typedef real vreal __attribute__ ((vector_size (VECTOR_BYTES)));
+typedef integer vmask __attribute__ ((vector_size (VECTOR_BYTES)));
+
+// Iteration, bei der z zum ersten Mal für die Erkennung periodischer Folgen gespeichert wird
+#define PERIODICITY_FIRST_CHECK 16
+
+// Anzahl Iterationen, die am Stück ohne Prüfung der einzelnen Lanes gerechnet werden. Mit AVX-512
+// kostet das Sammeln der Vergleiche in Masken so viel wie die Prüfung selbst, dort gibt es keine Blöcke.
+#if defined(__AVX512F__)
+	#define ESCAPE_BLOCK 1
+#else
+	#define ESCAPE_BLOCK 8
+#endif
+
+// Der Logarithmus ist langsam, daher wird log(2) vorberechnet
+static const real logof2 = 0.6931471806;
+
+/*
+ * Fasst eine Maske zu einer Bitmaske zusammen (Bit k entspricht Lane k)
+ *
+ * Arguments:
+ *  m - Maske aus einem Vektorvergleich (0 oder -1 pro Lane)
+ *
+ * Returns:
+ *  Die Bitmaske, 0 wenn kein Lane gesetzt ist
+ */
+__attribute__ ((hot)) static inline unsigned int laneBits(vmask m)
+{
+#if defined(__AVX512F__) && defined(KERNEL_DOUBLE)
+	return _mm512_test_epi64_mask((__m512i)m, (__m512i)m);
+#elif defined(__AVX512F__)
+	return _mm512_test_epi32_mask((__m512i)m, (__m512i)m);
+#elif defined(__AVX2__) && defined(KERNEL_DOUBLE)
+	return _mm256_movemask_pd((__m256d)m);
+#elif defined(__AVX2__)
+	return _mm256_movemask_ps((__m256)m);
+#elif defined(KERNEL_DOUBLE)
+	return _mm_movemask_pd((__m128d)m);
+#else
+	return _mm_movemask_ps((__m128)m);
+#endif
+}
+
+/*
+ * Wählt pro Lane zwischen zwei Vektoren aus
+ *
+ * Arguments:
+ *  m - Maske (-1 pro Lane in dem a gewählt wird, 0 für b)
+ *  a - Werte für gesetzte Lanes
+ *  b - Werte für nicht gesetzte Lanes
+ * 
+ * Returns:
+ *  Die zusammengesetzten Werte
+ */
+__attribute__ ((hot)) static inline vreal selectLanes(vmask m, vreal a, vreal b)
+{
+	return (vreal)(((vmask)a & m) | ((vmask)b & ~m));
+}
+
+/*
+ * Logarithmus zur Basis 2 für positive, endliche Zahlen ohne libm: der Exponent kommt aus
+ * den Bits, die Mantisse m in [sqrt(1/2), sqrt(2)) geht über die Reihe
+ * ln(m) = 2 atanh(s) = 2 (s + s^3/3 + s^5/5 + ...) mit s = (m-1)/(m+1), |s| < 0.172.
+ * Der erste weggelassene Term ist in float kleiner als 5e-8, in double kleiner als 1e-11.
+ *
+ * Arguments:
+ *  x - Die Zahlen
+ *
+ * Returns:
+ *  log2(x) für jedes Lane
+ */
+__attribute__ ((hot)) static inline vreal fastLog2(vreal x)
+{
+#ifdef KERNEL_DOUBLE
+	const vmask mantissa = (vmask){0} + 0x000FFFFFFFFFFFFFLL;
+	const vmask one = (vmask){0} + 0x3FF0000000000000LL;
+	vmask exponent = (((vmask)x >> 52) & 0x7FF) - 1023;
+#else
+	const vmask mantissa = (vmask){0} + 0x007FFFFF;
+	const vmask one = (vmask){0} + 0x3F800000;
+	vmask exponent = (((vmask)x >> 23) & 0xFF) - 127;
+#endif
+	vreal m = (vreal)(((vmask)x & mantissa) | one);
+
+	// Mantissen ab sqrt(2) halbieren, damit |s| klein bleibt
+	vmask high = m > (real)1.4142135623730951;
+	m = selectLanes(high, m * (real)0.5, m);
+	exponent -= high;
+
+	vreal s = (m - 1) / (m + 1);
+	vreal s2 = s * s;
+	const real log2e2 = 2.8853900817779268;   // 2 / ln(2)
+#ifdef KERNEL_DOUBLE
+	vreal series = 1 + s2 * ((real)(1.0/3) + s2 * ((real)0.2 + s2 * ((real)(1.0/7) + s2 * ((real)(1.0/9) + s2 * (real)(1.0/11)))));
+#else
+	vreal series = 1 + s2 * ((real)(1.0/3) + s2 * ((real)0.2 + s2 * (real)(1.0/7)));
+#endif
+	return __builtin_convertvector(exponent, vreal) + log2e2 * s * series;
+}
+
+/*
+ * Berechnet die Smooth-Coloring-Werte aller Lanes auf einmal
+ *
+ * Arguments:
+ *  iteration - Anzahl der Iterationen bis zum Verlassen des Radius
+ *  magnitude - Quadrat des Betrags der ersten Zahl außerhalb des Radius
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *  logDegree - Logarithmus des Grads der Formel (log(2) für z^2 + c)
+ * 
+ * Returns:
+ *  Die geglätteten Iterationszahlen, als float unter maxIterations (das nur für Punkte in der Mandelbrot-Menge)
+ */
+__attribute__ ((hot)) static inline vreal smoothIterations(vmask iteration, vreal magnitude, int maxIterations, real logDegree)
+{
+	// log(log|z| / log 2) / log d = log2(log2(|z|^2) / 2) * log 2 / log d
+	vreal n = __builtin_convertvector(iteration, vreal);
+	vreal smooth = n + 1 - fastLog2(fastLog2(magnitude) * (real)0.5) * (logof2 / logDegree);
+
+	// Knapp außerhalb des Radius rundet der Wert für n = maxIterations - 1 (spätestens als float)
+	// auf maxIterations, der Punkt würde dann als Teil der Menge gefärbt
+	const vreal belowMax = (vreal){0} + (real)nextafterf((float)maxIterations, 0);
+	smooth = selectLanes(smooth < belowMax, smooth, belowMax);
+	return selectLanes(iteration < maxIterations, smooth, n);
+}
+
+/*
+ * Logarithmus des Grads einer Formel, für smoothIterations
+ *
+ * Arguments:
+ *  formula - Eine der FORMULA_-Konstanten
+ *
+ * Returns:
+ *  log(3) und log(4) für die Multibrot-Formeln, sonst log(2)
+ */
+static inline real formulaLogDegree(int formula)
+{
+	if (formula == FORMULA_MULTIBROT3)
+		return 1.0986122887;
+	if (formula == FORMULA_MULTIBROT4)
+		return 2 * logof2;
+	return logof2;
+}
+
+/*
+ * Betrag jedes Lanes, durch Löschen des Vorzeichenbits
+ */
+__attribute__ ((hot)) static inline vreal absLanes(vreal a)
+{
+	const vreal sign = -(vreal){0};
+	return (vreal)((vmask)a & ~(vmask)sign);
+}
+
+/*
+ * Schätzt den Abstand eines Punktes zur Mandelbrotmenge aus z und dz/dc beim Entkommen
+ *
+ * Arguments:
+ *  iteration - Anzahl der Iterationen bis zum Verlassen des Radius
+ *  magnitude - Quadrat des Betrags von z
+ *  derivative - Quadrat des Betrags von dz/dc
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *
+ * Returns:
+ *  2|z|ln|z| / |dz/dc|, 0 für Punkte in der Menge
+ */
+static inline float distanceEstimate(int iteration, real magnitude, real derivative, int maxIterations)
+{
+	if (iteration >= maxIterations)
+		return 0;
+
+	// 2|z|ln|z| = |z|ln|z|², ist die Ableitung übergelaufen liegt der Punkt praktisch auf dem Rand
+	return sqrt(magnitude / derivative) * log(magnitude);
+}
+
+/*
+ * Prüft, ob Punkte in der Hauptkardioide oder im Kreis der Periode 2 links davon
+ * liegen. Diese Punkte gehören sicher zur Mandelbrotmenge, ihre Folge muss nicht
+ * iteriert werden.
+ *
+ * Arguments:
+ *  cr, ci - Die Punkte
+ *
+ * Returns:
+ *  Maske der Lanes, deren Punkt in der Kardioide oder im Kreis liegt
+ */
+__attribute__ ((hot)) static inline vmask insideCardioidOrBulb(vreal cr, vreal ci)
+{
+	vreal ci2 = ci * ci;
+	vreal xq = cr - (real)0.25;
+	vreal q = xq * xq + ci2;
+	vreal xb = cr + 1;
+	return (q * (q + xq) <= (real)0.25 * ci2) | (xb * xb + ci2 <= (real)0.0625);
+}
+
+/*
+ * Liefert den nächsten Punkt eines Laufs, der noch iteriert werden muss. Übersprungene
+ * Punkte in der Menge bekommen dabei die neue Grenze als Ergebnis.
+ *
+ * Arguments:
+ *  state - Zustand der Punkte oder NULL, dann wird kein Punkt übersprungen
+ *  next - Nächster noch nicht vergebener Punkt, wird weitergezählt
+ *  count - Anzahl der Punkte
+ *  maxIterations - Ergebnis für Punkte in der Menge
+ *  iterations - Ergebnisse der Punkte
+ *
+ * Returns:
+ *  Index des Punktes, -1 wenn keiner mehr übrig ist
+ */
+__attribute__ ((hot)) static inline int nextPoint(const struct EscapeState *state, int *next, int count, int maxIterations, float *iterations)
+{
+	if (state)
+		for (; *next < count && state->iteration[*next] < 0; (*next)++)
+			if (state->iteration[*next] == INSIDE)
+				iterations[*next] = maxIterations;
+
+	return *next < count ? (*next)++ : -1;
+}
+
+/*
+ * Lädt den gespeicherten Zustand der Punkte in die Lanes einer Maske
+ *
+ * Arguments:
+ *  state - Zustand der Punkte
+ *  point - Punkt jedes Lanes (-1 für leere Lanes)
+ *  mask - Die Lanes, die geladen werden
+ *  zr, zi, iteration - Register der Lanes
+ *
+ * Returns:
+ *  Nicht 0 wenn ein Punkt nicht bei z = 0 beginnt
+ */
+static inline int loadState(const struct EscapeState *state, vmask point, vmask mask, vreal *zr, vreal *zi, vmask *iteration)
+{
+	vreal zrLanes = *zr;
+	vreal ziLanes = *zi;
+	vmask iterationLanes = *iteration;
+	int resumed = 0;
+
+	for (unsigned int lanes = laneBits(mask & (point >= 0)); lanes; lanes &= lanes - 1)
+	{
+		int k = __builtin_ctz(lanes);
+		zrLanes[k] = state->zr[point[k]];
+		ziLanes[k] = state->zi[point[k]];
+		iterationLanes[k] = state->iteration[point[k]];
+		resumed |= iterationLanes[k];
+	}
+
+	*zr = zrLanes;
+	*zi = ziLanes;
+	*iteration = iterationLanes;
+	return resumed;
+}
+
+/*
+ * Hält fest, wie es mit einem fertigen Punkt weitergeht
+ *
+ * Arguments:
+ *  state - Zustand der Punkte
+ *  p - Index des Punktes
+ *  zr, zi - Letztes Folgeglied des Punktes
+ *  iteration - Anzahl ausgeführter Iterationen
+ *  escaped - Nicht 0 wenn der Punkt vor maxIterations entkommen ist
+ *  inside - Nicht 0 wenn der Punkt sicher zur Menge gehört
+ */
+static inline void saveState(const struct EscapeState *state, int p, real zr, real zi, int iteration, int escaped, int inside)
+{
+	if (escaped || inside)
+	{
+		state->iteration[p] = escaped ? ESCAPED : INSIDE;
+		return;
+	}
+
+	state->zr[p] = zr;
+	state->zi[p] = zi;
+	state->iteration[p] = iteration;
+}
+
+/*
+ * Berechnet die Koordinaten der Punkte in den Lanes, aus den Pixelindizes oder aus vorgegebenen Koordinaten
+ *
+ * Arguments:
+ *  pointsRe, pointsIm - Vorgegebene Koordinaten der Punkte oder NULL
+ *  ulRe, ulIm, dx, dy, x, y, stepX, stepY - Lage der Pixel des Laufs, wenn keine Koordinaten vorgegeben sind
+ *  point - Punkt jedes Lanes (-1 für leere Lanes)
+ *  cr, ci - Erhalten die Koordinaten
+ */
+__attribute__ ((hot)) static inline void
+pointCoordinates(const double *pointsRe, const double *pointsIm, real ulRe, real ulIm, real dx, real dy,
+                 int x, int y, int stepX, int stepY, vmask point, vreal *cr, vreal *ci)
+{
+	if (pointsRe)
+	{
+		vreal re = {0};
+		vreal im = {0};
+		for (int k = 0; k < VLEN; k++)
+		{
+			if (point[k] >= 0)
+			{
+				re[k] = pointsRe[point[k]];
+				im[k] = pointsIm[point[k]];
+			}
+		}
+		*cr = re;
+		*ci = im;
+		return;
+	}
+
+	*cr = __builtin_convertvector(x + point*stepX, vreal) * dx + ulRe;
+	*ci = __builtin_convertvector(y + point*stepY, vreal) * dy + ulIm;
+}
+
+/*
+ * Berechnet das nächste Folgeglied, die Formel steht zur Übersetzungszeit fest
+ *
+ * Arguments:
+ *  formula - Eine der FORMULA_-Konstanten
+ *  zr, zi - Das Folgeglied, wird ersetzt
+ *  zr2, zi2 - Quadrate von zr und zi
+ *  cr, ci - Die Konstante der Folge
+ */
+__attribute__ ((hot, always_inline)) static inline void
+formulaStep(int formula, vreal *zr, vreal *zi, vreal zr2, vreal zi2, vreal cr, vreal ci)
+{
+	if (formula == FORMULA_MULTIBROT3)
+	{
+		// z^3 = (zr^3 - 3 zr zi^2) + (3 zr^2 zi - zi^3) i
+		vreal t = *zr * (zr2 - 3 * zi2) + cr;
+		*zi = *zi * (3 * zr2 - zi2) + ci;
+		*zr = t;
+	}
+	else if (formula == FORMULA_MULTIBROT4)
+	{
+		// z^4 = (z^2)^2
+		vreal a = zr2 - zi2;
+		vreal b = *zr * *zi;
+		b += b;
+		*zr = (a * a - b * b) + cr;
+		*zi = 2 * (a * b) + ci;
+	}
+	else
+	{
+		// Das Burning Ship quadriert (|zr| + |zi| i), nur das Vorzeichen von zr*zi ändert sich
+		vreal t = *zr * *zi;
+		if (formula == FORMULA_BURNING_SHIP)
+			t = absLanes(t);
+		*zr = (zr2 - zi2) + cr;
+		*zi = (t + t) + ci;
+	}
+}
+
+/*
+ * Berechnet die nächste Ableitung dz/dc, dz_{n+1} = 2 z_n dz_n + 1
+ *
+ * Arguments:
+ *  zr, zi - Das alte Folgeglied
+ *  dzr, dzi - Die Ableitung, wird ersetzt
+ */
+__attribute__ ((hot, always_inline)) static inline void
+derivativeStep(vreal zr, vreal zi, vreal *dzr, vreal *dzi)
+{
+	vreal u = zr * *dzr - zi * *dzi;
+	vreal v = zr * *dzi + zi * *dzr;
+	*dzr = (u + u) + 1;
+	*dzi = v + v;
+}
+
+/*
+ * Executes the complex series for a run of points for up to maxIterations.
+ * Point p of the run is pixel (x + p*stepX, y + p*stepY), a row has stepY = 0.
+ * Instead of pixels, the points can also be given by their coordinates.
+ * Every lane works on its own point. As soon as the series of a lane escapes
+ * (or reaches maxIterations), its result is written back and the lane is
+ * refilled with the next pending point of the run, so no lane idles while its
+ * neighbours are still iterating.
+ *
+ * With a state, every point continues where the state says and points that
+ * are already decided are skipped. Points that reach maxIterations without
+ * being decided store their z in the state again.
+ *
+ * With distances, the derivative dz/dc is iterated alongside z and every
+ * escaping point gets the estimate 2|z|ln|z| / |dz/dc| of its distance to
+ * the Mandelbrot set; points in the set get 0.
+ *
+ * The formula is always passed as a constant, so every caller gets its own
+ * copy of the loop with only that formula's step in it. State and distances
+ * are only supported for FORMULA_MANDELBROT.
+ *
+ * While no lane can reach maxIterations or its next periodicity check, the
+ * loop runs blocks of ESCAPE_BLOCK iterations that only collect the escape
+ * and cycle tests of every step, and looks at the lanes once per block. A
+ * lane that stopped inside a block is set back to the step where it stopped,
+ * so every point ends at exactly the same iteration with exactly the same z
+ * as without blocks.
+ *
+ * Arguments:
+ *  ulRe, ulIm - Upper left point of the viewport
+ *  dx, dy - Distance between two pixels
+ *  x, y - First pixel of the run
+ *  stepX, stepY - Distance between two pixels of the run, in pixels
+ *  pointsRe, pointsIm - Coordinates of the points, NULL for the pixels of the run
+ *  count - Number of points
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *  formula - One of the FORMULA_ constants
+ *  seedRe, seedIm - The constant c of FORMULA_JULIA, the points are z_0 then
+ *  state - State of every point, NULL to start all points at z = 0
+ *	iterations - Receives the smoothed iteration number for every point
+ *  distances - Receives the distance estimate for every point, NULL if it is not needed
+ */
+__attribute__ ((hot, always_inline)) static inline void
+testEscapeSeriesForPoint(real ulRe, real ulIm, real dx, real dy, int x, int y, int stepX, int stepY,
+                         const double *pointsRe, const double *pointsIm, int count, int maxIterations,
+                         int formula, real seedRe, real seedIm,
+                         const struct EscapeState *state, float *iterations, float *distances)
+{
+	const int julia = formula == FORMULA_JULIA;
+	const real logDegree = formulaLogDegree(formula);
+
+	// Statt den Betrag mit dem Radius zu vergleichen, vergleichen wir die Quadrate (spart die Wurzel).
+	// Die Abstandsschätzung ist erst bei größerem |z| genau genug.
+	const real radius = distances ? (real)DISTANCE_RADIUS : (real)RADIUS;
+	const vreal r = (vreal){0} + radius * radius;
+	const vmask maxIt = (vmask){0} + maxIterations;
+
+	vreal zr = {0};
+	vreal zi = {0};
+	vmask iteration = {0};
+
+	// Ableitung dz/dc für die Abstandsschätzung, dz_0 = 0
+	vreal dzr = {0};
+	vreal dzi = {0};
+
+	// Erkennung periodischer Folgen nach Brent: z wird bei Iteration checkAt gespeichert, dann verdoppelt sich
+	// checkAt. Kommt z exakt wieder, wiederholt sich die restliche Folge und der Punkt entkommt nie. NaN passt
+	// auf nichts und markiert Lanes ohne gespeichertes z.
+	const vreal unsaved = (vreal){0} + (real)__builtin_nan("");
+	const vmask firstCheck = (vmask){0} + PERIODICITY_FIRST_CHECK;
+	vreal savedZr = unsaved;
+	vreal savedZi = unsaved;
+	vmask checkAt = firstCheck;
+
+	// welcher Punkt in welchem Lane läuft (-1 für leere Lanes), und welcher als nächstes an der Reihe ist
+	vmask point;
+	int next = 0;
+
+	for (int k = 0; k < VLEN; k++)
+		point[k] = nextPoint(state, &next, count, maxIterations, iterations);
+
+	// Die Koordinaten werden aus den Pixelindizes berechnet, damit jeder Pixel unabhängig vom Lauf den gleichen Wert bekommt
+	vmask occupied = point >= 0;
+	vreal cr;
+	vreal ci;
+	pointCoordinates(pointsRe, pointsIm, ulRe, ulIm, dx, dy, x, y, stepX, stepY, point, &cr, &ci);
+
+	// Bei Julia-Mengen ist der Punkt z_0 und c für alle gleich
+	if (julia)
+	{
+		zr = cr;
+		zi = ci;
+		cr = (vreal){0} + seedRe;
+		ci = (vreal){0} + seedIm;
+	}
+
+	// Mit einem Zustand kann schon der ganze Lauf entschieden sein
+	if (!laneBits(occupied))
+		return;
+
+	if (state)
+	{
+		loadState(state, point, occupied, &zr, &zi, &iteration);
+		checkAt = iteration + firstCheck;
+	}
+
+	// Punkte in Kardioide und Kreis sind nach dem ersten Schritt fertig (mit maxIterations). Solche Punkte
+	// stehen in einem Zustand immer als INSIDE, ihre Iterationszahl ist also hier noch 0. Die Abkürzung
+	// gilt nur für z^2 + c.
+	vmask settled = formula == FORMULA_MANDELBROT ? insideCardioidOrBulb(cr, ci) & occupied : (vmask){0};
+	iteration |= (maxIt - 1) & settled;
+
+	while (1)
+	{
+		vreal zr2 = zr * zr;
+		vreal zi2 = zi * zi;
+		vreal m = zr2 + zi2;
+
+		// Periodische Punkte sind fertig, als hätten sie maxIterations erreicht
+		vmask cycled = (zr == savedZr) & (zi == savedZi);
+		iteration = (iteration & ~cycled) | (maxIt & cycled);
+		settled |= cycled;
+
+		// Lanes, deren Punkt den Radius verlassen oder maxIterations erreicht hat
+		vmask doneMask = ((m > r) | (iteration == maxIt)) & occupied;
+		unsigned int done = laneBits(doneMask);
+
+		if (done)
+		{
+			// Ergebnisse zurückschreiben und den Lanes die nächsten Punkte der Zeile zuteilen.
+			// Die Kopien sorgen dafür, dass nur sie (und nicht die Register der Schleife) im Speicher landen.
+			vmask pointLanes = point;
+			vmask iterationLanes = iteration;
+			vreal magnitudeLanes = m;
+			vreal derivativeLanes = dzr * dzr + dzi * dzi;
+			vreal smoothLanes = smoothIterations(iteration, m, maxIterations, logDegree);
+			for (; done; done &= done - 1)
+			{
+				int k = __builtin_ctz(done);
+				iterations[pointLanes[k]] = smoothLanes[k];
+				if (distances)
+					distances[pointLanes[k]] = distanceEstimate(iterationLanes[k], magnitudeLanes[k], derivativeLanes[k], maxIterations);
+				// Ein Punkt, der genau bei maxIterations entkommt, bekommt mit einer höheren Grenze einen anderen Wert
+				if (state)
+					saveState(state, pointLanes[k], zr[k], zi[k], iterationLanes[k],
+					          magnitudeLanes[k] > r[k] && iterationLanes[k] < maxIterations, settled[k]);
+				pointLanes[k] = nextPoint(state, &next, count, maxIterations, iterations);
+			}
+			point = pointLanes;
+
+			// Wenn alle Lanes leer sind ist der Lauf fertig
+			occupied = point >= 0;
+			if (!laneBits(occupied))
+				break;
+
+			// Die neu befüllten Lanes starten bei z = 0 (leere Lanes rechnen folgenlos mit)
+			zr = (vreal)((vmask)zr & ~doneMask);
+			zi = (vreal)((vmask)zi & ~doneMask);
+			zr2 = (vreal)((vmask)zr2 & ~doneMask);
+			zi2 = (vreal)((vmask)zi2 & ~doneMask);
+			dzr = (vreal)((vmask)dzr & ~doneMask);
+			dzi = (vreal)((vmask)dzi & ~doneMask);
+			iteration &= ~doneMask;
+			vreal refillRe;
+			vreal refillIm;
+			pointCoordinates(pointsRe, pointsIm, ulRe, ulIm, dx, dy, x, y, stepX, stepY, point, &refillRe, &refillIm);
+			if (julia)
+			{
+				zr = selectLanes(doneMask, refillRe, zr);
+				zi = selectLanes(doneMask, refillIm, zi);
+			}
+			else
+			{
+				cr = selectLanes(doneMask, refillRe, cr);
+				ci = selectLanes(doneMask, refillIm, ci);
+			}
+			int resumed = state && loadState(state, point, doneMask, &zr, &zi, &iteration);
+			savedZr = selectLanes(doneMask, unsaved, savedZr);
+			savedZi = selectLanes(doneMask, unsaved, savedZi);
+			checkAt = (checkAt & ~doneMask) | ((iteration + firstCheck) & doneMask);
+			if (formula == FORMULA_MANDELBROT)
+			{
+				settled = (settled & ~doneMask) | (insideCardioidOrBulb(cr, ci) & doneMask);
+				iteration |= (maxIt - 1) & settled & doneMask;
+			}
+			else
+				settled &= ~doneMask;
+
+			// Fortgesetzte Punkte und die z_0 von Julia-Mengen können schon entkommen sein, sie
+			// werden vor dem nächsten Schritt geprüft
+			if (resumed || julia)
+				continue;
+		}
+
+#if ESCAPE_BLOCK > 1
+		// Ein Block passt, wenn in ihm kein belegtes Lane maxIterations oder seine nächste Speicherung erreicht.
+		// Die meisten Punkte entkommen nach wenigen Iterationen, daher laufen die ersten einzeln.
+		vmask blockFits = (checkAt - iteration >= ESCAPE_BLOCK) & (maxIt - iteration >= ESCAPE_BLOCK) & (iteration >= ESCAPE_BLOCK);
+		if (!laneBits(occupied & ~blockFits))
+		{
+			// Die Glieder z_{n+1} ... z_{n+ESCAPE_BLOCK} werden aufgehoben, z_n ist schon geprüft
+			vreal stepZr[ESCAPE_BLOCK];
+			vreal stepZi[ESCAPE_BLOCK];
+			vreal stepDzr[ESCAPE_BLOCK];
+			vreal stepDzi[ESCAPE_BLOCK];
+			vmask stopped = {0};
+			vmask firstStop = {0};
+
+			// Entkommen und Wiederholung werden nur gesammelt; NaN nach einem Überlauf zählt als entkommen.
+			// z_{n+ESCAPE_BLOCK} prüft wieder der Anfang der Schleife.
+			for (int j = 0; ; j++)
+			{
+				if (distances)
+				{
+					derivativeStep(zr, zi, &dzr, &dzi);
+					stepDzr[j] = dzr;
+					stepDzi[j] = dzi;
+				}
+				formulaStep(formula, &zr, &zi, zr2, zi2, cr, ci);
+				stepZr[j] = zr;
+				stepZi[j] = zi;
+				if (j == ESCAPE_BLOCK - 1)
+					break;
+
+				zr2 = zr * zr;
+				zi2 = zi * zi;
+				vmask stop = ~(zr2 + zi2 <= r) | ((zr == savedZr) & (zi == savedZi));
+				firstStop = (firstStop & (stopped | ~stop)) | (((vmask){0} + j) & ~stopped & stop);
+				stopped |= stop;
+			}
+			iteration += ((vmask){0} + ESCAPE_BLOCK) & occupied;
+
+			// Lanes, die im Block fertig geworden sind, gehen auf das Glied zurück, bei dem sie aufgehört
+			// haben; der Anfang der Schleife behandelt sie dann wie ohne Block
+			unsigned int stoppedLanes = laneBits(stopped & occupied);
+			if (stoppedLanes)
+			{
+				vreal zrLanes = zr;
+				vreal ziLanes = zi;
+				vreal dzrLanes = dzr;
+				vreal dziLanes = dzi;
+				vmask iterationLanes = iteration;
+				for (; stoppedLanes; stoppedLanes &= stoppedLanes - 1)
+				{
+					int k = __builtin_ctz(stoppedLanes);
+					int j = firstStop[k];
+					zrLanes[k] = stepZr[j][k];
+					ziLanes[k] = stepZi[j][k];
+					if (distances)
+					{
+						dzrLanes[k] = stepDzr[j][k];
+						dziLanes[k] = stepDzi[j][k];
+					}
+					iterationLanes[k] -= ESCAPE_BLOCK - 1 - j;
+				}
+				zr = zrLanes;
+				zi = ziLanes;
+				dzr = dzrLanes;
+				dzi = dziLanes;
+				iteration = iterationLanes;
+			}
+			continue;
+		}
+#endif
+
+		vmask save = iteration == checkAt;
+		savedZr = selectLanes(save, zr, savedZr);
+		savedZi = selectLanes(save, zi, savedZi);
+		checkAt += checkAt & save;
+
+		// occupied ist -1 für belegte Lanes, d.h. Subtraktion inkrementiert
+		iteration -= occupied;
+
+		// dz_{n+1} = 2 z_n dz_n + 1, mit dem alten z
+		if (distances)
+			derivativeStep(zr, zi, &dzr, &dzi);
+
+		// Folge für n+1 berechnen
+		formulaStep(formula, &zr, &zi, zr2, zi2, cr, ci);
+	}
+}
+
+/*
+ * Iterates the Mandelbrot series for a run of pixels of the viewport.
+ */
+void
+KERNEL(escapeRun)(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations)
+{
+	// Die Schrittweiten werden in der Genauigkeit des Kernels berechnet
+	real ulRe = view->upperLeftRe;
+	real ulIm = view->upperLeftIm;
+	real dx = ((real)view->lowerRightRe - ulRe)/view->width;   // die "Schrittgröße" für eine x-Iteration
+	real dy = ((real)view->lowerRightIm - ulIm)/view->height;  // die "Schrittgröße" für eine y-Iteration
+
+	testEscapeSeriesForPoint(ulRe, ulIm, dx, dy, x, y, stepX, stepY, NULL, NULL, count, maxIterations, FORMULA_MANDELBROT, 0, 0, NULL, iterations, NULL);
+}
+
+/*
+ * Iterates a run of pixels of the viewport with one of the formulas.
+ */
+void
+KERNEL(formulaRun)(const struct Formula *formula, const struct Viewport *view, int maxIterations,
+                   int x, int y, int stepX, int stepY, int count, float *iterations)
+{
+	real ulRe = view->upperLeftRe;
+	real ulIm = view->upperLeftIm;
+	real dx = ((real)view->lowerRightRe - ulRe)/view->width;
+	real dy = ((real)view->lowerRightIm - ulIm)/view->height;
+	real seedRe = formula->seedRe;
+	real seedIm = formula->seedIm;
+
+	// Jeder Fall bekommt seine eigene Kopie der Schleife
+	switch (formula->type)
+	{
+		case FORMULA_JULIA:
+			testEscapeSeriesForPoint(ulRe, ulIm, dx, dy, x, y, stepX, stepY, NULL, NULL, count, maxIterations, FORMULA_JULIA, seedRe, seedIm, NULL, iterations, NULL);
+			break;
+		case FORMULA_MULTIBROT3:
+			testEscapeSeriesForPoint(ulRe, ulIm, dx, dy, x, y, stepX, stepY, NULL, NULL, count, maxIterations, FORMULA_MULTIBROT3, 0, 0, NULL, iterations, NULL);
+			break;
+		case FORMULA_MULTIBROT4:
+			testEscapeSeriesForPoint(ulRe, ulIm, dx, dy, x, y, stepX, stepY, NULL, NULL, count, maxIterations, FORMULA_MULTIBROT4, 0, 0, NULL, iterations, NULL);
+			break;
+		case FORMULA_BURNING_SHIP:
+			testEscapeSeriesForPoint(ulRe, ulIm, dx, dy, x, y, stepX, stepY, NULL, NULL, count, maxIterations, FORMULA_BURNING_SHIP, 0, 0, NULL, iterations, NULL);
+			break;
+		default:
+			KERNEL(escapeRun)(view, maxIterations, x, y, stepX, stepY, count, iterations);
+	}
+}
+
+/*
+ * Iterates a run of pixels of the viewport, continuing from a saved state.
+ */
+void
+KERNEL(resumeRun)(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count,
+                  const struct EscapeState *state, float *iterations)
+{
+	real ulRe = view->upperLeftRe;
+	real ulIm = view->upperLeftIm;
+	real dx = ((real)view->lowerRightRe - ulRe)/view->width;
+	real dy = ((real)view->lowerRightIm - ulIm)/view->height;
+
+	testEscapeSeriesForPoint(ulRe, ulIm, dx, dy, x, y, stepX, stepY, NULL, NULL, count, maxIterations, FORMULA_MANDELBROT, 0, 0, state, iterations, NULL);
+}
+
+/*
+ * Iterates points given by their coordinates and estimates their distance to the set.
+ */
+void
+KERNEL(estimatePoints)(const double *cr, const double *ci, int count, int maxIterations, float *iterations, float *distances)
+{
+	testEscapeSeriesForPoint(0, 0, 0, 0, 0, 0, 0, 0, cr, ci, count, maxIterations, FORMULA_MANDELBROT, 0, 0, NULL, iterations, distances);
+}
+
+/*
+ * Iterates the Mandelbrot series for points given by their coordinates.
+ */
+void
+KERNEL(escapePoints)(const double *cr, const double *ci, int count, int maxIterations, float *iterations)
+{
+	testEscapeSeriesForPoint(0, 0, 0, 0, 0, 0, 0, 0, cr, ci, count, maxIterations, FORMULA_MANDELBROT, 0, 0, NULL, iterations, NULL);
+}
+
+/*
+ * Iterates the Mandelbrot series for every pixel of row y of the viewport.
+ */
+void
+KERNEL(escapeRow)(const struct Viewport *view, int maxIterations, int y, float *iterations)
+{
+	KERNEL(escapeRun)(view, maxIterations, 0, y, 1, 0, view->width, iterations);
+}
+
+#ifdef KERNEL_DOUBLE
+
+// Glitch, wenn |z|^2 < GLITCH_TOLERANCE * |Z|^2 (Kriterium nach Pauldelbrot, 1e-3 für die Beträge)
+#define GLITCH_TOLERANCE 1e-6
+
+/*
+ * Iterates points as offsets to a reference orbit. All lanes run in lockstep,
+ * so the reference value Z_n is the same for all of them and can be broadcast.
+ */
+void
+KERNEL(perturbPoints)(const struct ReferenceOrbit *ref, const double *dcr, const double *dci, int count, int maxIterations, int detectGlitches, float *iterations)
+{
+	const vreal r = (vreal){0} + (real)(RADIUS*RADIUS);
+	const vmask glitchDetection = (vmask){0} - (detectGlitches != 0);
+
+	for (int p = 0; p < count; p += VLEN)
+	{
+		// Der letzte Block wird mit dem letzten Punkt aufgefüllt
+		vreal cr;
+		vreal ci;
+		for (int k = 0; k < VLEN; k++)
+		{
+			int q = p+k < count ? p+k : count-1;
+			cr[k] = dcr[q];
+			ci[k] = dci[q];
+		}
+
+		vreal dr = {0};
+		vreal di = {0};
+		vmask active = (vmask){0} == 0;
+		int n;
+
+		for (n = 0; n < maxIterations && n < ref->length; n++)
+		{
+			const real Zr = ref->zr[n];
+			const real Zi = ref->zi[n];
+			vreal zr = Zr + dr;
+			vreal zi = Zi + di;
+			vreal m = zr*zr + zi*zi;
+
+			// Entkommene Punkte und Glitches bekommen ihr Ergebnis
+			vmask escaped = (m > r) & active;
+			vmask glitched = (m < GLITCH_TOLERANCE * (Zr*Zr + Zi*Zi)) & active & ~escaped & glitchDetection;
+			unsigned int done = laneBits(escaped | glitched);
+
+			if (done)
+			{
+				vmask escapedLanes = escaped;
+				vreal smoothLanes = smoothIterations((vmask){0} + n, m, maxIterations, logof2);
+				for (; done; done &= done - 1)
+				{
+					int k = __builtin_ctz(done);
+					if (p+k < count)
+						iterations[p+k] = escapedLanes[k] ? smoothLanes[k] : GLITCHED;
+				}
+
+				active &= ~(escaped | glitched);
+				if (!laneBits(active))
+					break;
+			}
+
+			// dz_{n+1} = 2 Z_n dz_n + dz_n^2 + dc
+			vreal t = 2*(Zr*dr - Zi*di) + (dr*dr - di*di) + cr;
+			di = 2*(Zr*di + Zi*dr) + 2*dr*di + ci;
+			dr = t;
+		}
+
+		// Punkte, die noch laufen, liegen in der Menge - oder haben die Referenz überlebt
+		unsigned int remaining = laneBits(active);
+		for (; remaining; remaining &= remaining - 1)
+		{
+			int k = __builtin_ctz(remaining);
+			if (p+k < count)
+				iterations[p+k] = n < maxIterations && detectGlitches ? GLITCHED : maxIterations;
+		}
+	}
+}
+
+/*
+ * Double-double-Arithmetik: eine Zahl ist die unausgewertete Summe hi + lo zweier
+ * doubles mit |lo| <= ulp(hi)/2, das ergibt etwa 106 Bit Mantisse.
+ */
+typedef struct {
+	vreal hi;
+	vreal lo;
+} vdd;
+
+/*
+ * Addiert zwei Zahlen exakt (Knuth)
+ *
+ * Arguments:
+ *  a, b - Summanden
+ *  error - Erhält den Rundungsfehler der Summe
+ *
+ * Returns:
+ *  Die gerundete Summe, zusammen mit error exakt a + b
+ */
+__attribute__ ((hot)) static inline vreal twoSum(vreal a, vreal b, vreal *error)
+{
+	vreal s = a + b;
+	vreal v = s - a;
+	*error = (a - (s - v)) + (b - v);
+	return s;
+}
+
+/*
+ * Wie twoSum, setzt aber |a| >= |b| voraus und ist dafür billiger (Dekker)
+ */
+__attribute__ ((hot)) static inline vreal quickTwoSum(vreal a, vreal b, vreal *error)
+{
+	vreal s = a + b;
+	*error = b - (s - a);
+	return s;
+}
+
+/*
+ * Multipliziert zwei Zahlen exakt
+ *
+ * Arguments:
+ *  a, b - Faktoren
+ *  error - Erhält den Rundungsfehler des Produkts
+ *
+ * Returns:
+ *  Das gerundete Produkt, zusammen mit error exakt a * b
+ */
+__attribute__ ((hot)) static inline vreal twoProd(vreal a, vreal b, vreal *error)
+{
+	vreal p = a * b;
+#if defined(__AVX512F__)
+	*error = (vreal)_mm512_fmsub_pd((__m512d)a, (__m512d)b, (__m512d)p);
+#elif defined(__FMA__)
+	*error = (vreal)_mm256_fmsub_pd((__m256d)a, (__m256d)b, (__m256d)p);
+#else
+	// Ohne FMA werden die Faktoren in 26-Bit-Hälften zerlegt, deren Produkte exakt sind (Dekker)
+	const real split = 134217729.0; // 2^27 + 1
+	vreal t = split * a;
+	vreal aHi = t - (t - a);
+	vreal aLo = a - aHi;
+	t = split * b;
+	vreal bHi = t - (t - b);
+	vreal bLo = b - bHi;
+	*error = ((aHi*bHi - p) + aHi*bLo + aLo*bHi) + aLo*bLo;
+#endif
+	return p;
+}
+
+// Grundrechenarten auf double-double, nach der QD-Bibliothek von Hida, Li und Bailey
+__attribute__ ((hot)) static inline vdd ddAdd(vdd a, vdd b)
+{
+	vreal e, f;
+	vreal s = twoSum(a.hi, b.hi, &e);
+	vreal t = twoSum(a.lo, b.lo, &f);
+	e += t;
+	s = quickTwoSum(s, e, &e);
+	e += f;
+	s = quickTwoSum(s, e, &e);
+	return (vdd){s, e};
+}
+
+__attribute__ ((hot)) static inline vdd ddSub(vdd a, vdd b)
+{
+	return ddAdd(a, (vdd){-b.hi, -b.lo});
+}
+
+__attribute__ ((hot)) static inline vdd ddMul(vdd a, vdd b)
+{
+	vreal e;
+	vreal p = twoProd(a.hi, b.hi, &e);
+	e += a.hi*b.lo + a.lo*b.hi;
+	p = quickTwoSum(p, e, &e);
+	return (vdd){p, e};
+}
+
+__attribute__ ((hot)) static inline vdd ddSqr(vdd a)
+{
+	vreal e;
+	vreal p = twoProd(a.hi, a.hi, &e);
+	e += 2*(a.hi*a.lo);
+	p = quickTwoSum(p, e, &e);
+	return (vdd){p, e};
+}
+
+/*
+ * Setzt die Lanes einer Zahl auf 0
+ *
+ * Arguments:
+ *  a - Die Zahl
+ *  m - Maske der Lanes, die auf 0 gesetzt werden
+ */
+__attribute__ ((hot)) static inline vdd ddClearLanes(vdd a, vmask m)
+{
+	return (vdd){(vreal)((vmask)a.hi & ~m), (vreal)((vmask)a.lo & ~m)};
+}
+
+/*
+ * Berechnet den Realteil der Punkte, die in den Lanes laufen
+ *
+ * Arguments:
+ *  view - Der Ausschnitt
+ *  point - Index des Punkts in der Zeile für jede Lane
+ */
+__attribute__ ((hot)) static inline vdd ddPointRe(const struct DeepViewport *view, vmask point)
+{
+	// Der Abstand zur Mitte ist klein genug für ein einfaches double
+	real dx = view->spanRe / view->width;
+	vreal offset = __builtin_convertvector(point, vreal) * dx - view->spanRe/2;
+	vdd center = {(vreal){0} + view->centerReHi, (vreal){0} + view->centerReLo};
+	return ddAdd(center, (vdd){offset, (vreal){0}});
+}
+
+/*
+ * Iterates the Mandelbrot series for every pixel of row y of the viewport in
+ * double-double precision. Works like testEscapeSeriesForPoint, lanes are
+ * refilled as soon as their point is finished.
+ */
+void
+KERNEL_NAME(escapeRow, DoubleDouble, ISA)(const struct DeepViewport *view, int maxIterations, int y, float *iterations)
+{
+	const vreal r = (vreal){0} + (real)(RADIUS*RADIUS);
+	const vmask maxIt = (vmask){0} + maxIterations;
+	const int width = view->width;
+
+	// Imaginärteil der Zeile
+	real dy = view->spanIm / view->height;
+	vdd ci = ddAdd((vdd){(vreal){0} + view->centerImHi, (vreal){0} + view->centerImLo},
+	               (vdd){(vreal){0} + (view->spanIm/2 - dy*y), (vreal){0}});
+
+	vdd zr = {{0}, {0}};
+	vdd zi = {{0}, {0}};
+	vmask iteration = {0};
+
+	// Erkennung periodischer Folgen wie in testEscapeSeriesForPoint, verglichen werden die führenden Teile
+	const vreal unsaved = (vreal){0} + (real)__builtin_nan("");
+	const vmask firstCheck = (vmask){0} + PERIODICITY_FIRST_CHECK;
+	vreal savedZr = unsaved;
+	vreal savedZi = unsaved;
+	vmask checkAt = firstCheck;
+
+	vmask point;
+	int next = 0;
+
+	for (int k = 0; k < VLEN; k++)
+		point[k] = next < width ? next++ : -1;
+
+	vmask occupied = point >= 0;
+	vdd cr = ddPointRe(view, point);
+
+	// Punkte in Kardioide und Kreis sind nach dem ersten Schritt fertig, dafür reichen die führenden Teile von c
+	iteration |= (maxIt - 1) & insideCardioidOrBulb(cr.hi, ci.hi) & occupied;
+
+	while (1)
+	{
+		vdd zr2 = ddSqr(zr);
+		vdd zi2 = ddSqr(zi);
+
+		// Für den Radius reicht der führende Teil
+		vreal m = zr2.hi + zi2.hi;
+
+		// Periodische Punkte sind fertig, als hätten sie maxIterations erreicht
+		vmask cycled = (zr.hi == savedZr) & (zi.hi == savedZi);
+		iteration = (iteration & ~cycled) | (maxIt & cycled);
+
+		vmask doneMask = ((m > r) | (iteration == maxIt)) & occupied;
+		unsigned int done = laneBits(doneMask);
+
+		if (done)
+		{
+			vmask pointLanes = point;
+			vreal smoothLanes = smoothIterations(iteration, m, maxIterations, logof2);
+			for (; done; done &= done - 1)
+			{
+				int k = __builtin_ctz(done);
+				iterations[pointLanes[k]] = smoothLanes[k];
+				pointLanes[k] = next < width ? next++ : -1;
+			}
+			point = pointLanes;
+
+			occupied = point >= 0;
+			if (!laneBits(occupied))
+				break;
+
+			zr = ddClearLanes(zr, doneMask);
+			zi = ddClearLanes(zi, doneMask);
+			zr2 = ddClearLanes(zr2, doneMask);
+			zi2 = ddClearLanes(zi2, doneMask);
+			iteration &= ~doneMask;
+
+			vdd refill = ddPointRe(view, point);
+			cr.hi = selectLanes(doneMask, refill.hi, cr.hi);
+			cr.lo = selectLanes(doneMask, refill.lo, cr.lo);
+
+			savedZr = selectLanes(doneMask, unsaved, savedZr);
+			savedZi = selectLanes(doneMask, unsaved, savedZi);
+			checkAt = (checkAt & ~doneMask) | (firstCheck & doneMask);
+			iteration |= (maxIt - 1) & insideCardioidOrBulb(cr.hi, ci.hi) & doneMask & occupied;
+		}
+
+		vmask save = iteration == checkAt;
+		savedZr = selectLanes(save, zr.hi, savedZr);
+		savedZi = selectLanes(save, zi.hi, savedZi);
+		checkAt += checkAt & save;
+
+		iteration -= occupied;
+
+		// z_{n+1} = z_n^2 + c, die Verdopplung ist exakt
+		vdd t = ddMul(zr, zi);
+		zr = ddAdd(ddSub(zr2, zi2), cr);
+		zi = ddAdd((vdd){t.hi + t.hi, t.lo + t.lo}, ci);
+	}
+}
+
+#endif /* KERNEL_DOUBLE */
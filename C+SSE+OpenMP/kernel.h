@@ -0,0 +1,261 @@
+/*   Copyright (C) 2013 Daniel Thürck
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+#ifndef KERNEL_HEADER
+#define KERNEL_HEADER
+
+/*
+ * Section of the complex plane that is rendered, together with its sampling.
+ * The kernels derive their step sizes from it in their own precision.
+ */
+struct Viewport {
+	double upperLeftRe;
+	double upperLeftIm;
+	double lowerRightRe;
+	double lowerRightIm;
+	int width;
+	int height;
+};
+
+/*
+ * Iterates the Mandelbrot series for every pixel of row y of the viewport.
+ *
+ * Arguments:
+ *	view - The viewport that is rendered
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *	y - Index of the row
+ *	iterations - Array of view->width ints that receives the (smoothed) iteration numbers
+ */
+typedef void (*escapeRowFunc)(const struct Viewport *view, int maxIterations, int y, float *iterations);
+
+/*
+ * Iterates the Mandelbrot series for a run of pixels of the viewport, i.e. the
+ * pixels (x + p*stepX, y + p*stepY) for p = 0 ... count-1. A pixel gets the
+ * same result as from escapeRowFunc, no matter which run it belongs to.
+ *
+ * Arguments:
+ *	view - The viewport that is rendered
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *	x, y - First pixel of the run
+ *	stepX, stepY - Distance between two pixels of the run (1, 0 for a part of a row, 0, 1 for a part of a column)
+ *	count - Number of pixels
+ *	iterations - Array of count ints that receives the (smoothed) iteration numbers
+ */
+typedef void (*escapeRunFunc)(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+
+/*
+ * The series that is iterated instead of the Mandelbrot series: z^2 + seed
+ * with the point as z_0 (FORMULA_JULIA), z^3 + c, z^4 + c (FORMULA_MULTIBROT3/4)
+ * or (|Re z| + |Im z| i)^2 + c (FORMULA_BURNING_SHIP).
+ */
+struct Formula {
+	int type;         // eine der FORMULA_-Konstanten aus globals.h
+	double seedRe;    // c der Julia-Menge
+	double seedIm;
+};
+
+/*
+ * Like escapeRunFunc, but iterates the series of a formula. Every formula has
+ * its own copy of the loop, so the choice costs nothing per iteration, and
+ * FORMULA_MANDELBROT gives the same results as escapeRunFunc.
+ *
+ * Arguments:
+ *	formula - The formula
+ *	view, maxIterations, x, y, stepX, stepY, count, iterations - see escapeRunFunc
+ */
+typedef void (*formulaRunFunc)(const struct Formula *formula, const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+
+/*
+ * Where the series of the points of a run stopped, so that a higher
+ * maxIterations can continue them instead of starting over. The arrays are
+ * indexed like the iterations of the run.
+ */
+struct EscapeState {
+	double *zr;       // letztes Folgeglied
+	double *zi;
+	int *iteration;   // Anzahl ausgeführter Iterationen, ESCAPED oder INSIDE wenn das Ergebnis feststeht
+};
+
+// Zustand von Punkten, die entkommen sind
+#define ESCAPED -1
+// Zustand von Punkten, die sicher zur Menge gehören
+#define INSIDE -2
+
+/*
+ * Like escapeRunFunc, but every point continues from its state. Escaped points
+ * are skipped and keep their entry in iterations, points inside the set get
+ * maxIterations; the others get a new result and their state is updated. A state with z = 0 and 0 iterations for every
+ * point gives the same results as escapeRunFunc.
+ *
+ * Arguments:
+ *	view, maxIterations, x, y, stepX, stepY, count - see escapeRunFunc
+ *	state - State of every point of the run
+ *	iterations - Array of count floats that receives the (smoothed) iteration numbers
+ */
+typedef void (*resumeRunFunc)(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, const struct EscapeState *state, float *iterations);
+
+/*
+ * Iterates the Mandelbrot series for points anywhere in the complex plane,
+ * e.g. the jittered samples of anti-aliasing.
+ *
+ * Arguments:
+ *	cr - Real parts of the points
+ *	ci - Imaginary parts of the points
+ *	count - Number of points
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *	iterations - Array of count floats that receives the (smoothed) iteration numbers
+ */
+typedef void (*escapePointsFunc)(const double *cr, const double *ci, int count, int maxIterations, float *iterations);
+
+/*
+ * Like escapePointsFunc, but also iterates the derivative dz/dc of every
+ * point and estimates its distance to the Mandelbrot set from it.
+ *
+ * Arguments:
+ *	cr, ci, count, maxIterations, iterations - see escapePointsFunc
+ *	distances - Receives 2|z|ln|z| / |dz/dc| for escaping points, 0 for points in the set
+ */
+typedef void (*estimatePointsFunc)(const double *cr, const double *ci, int count, int maxIterations, float *iterations, float *distances);
+
+/*
+ * View of the double-double kernel. The centre is the unevaluated sum hi + lo
+ * of two doubles, the spans are small enough to be plain doubles.
+ */
+struct DeepViewport {
+	double centerReHi;
+	double centerReLo;
+	double centerImHi;
+	double centerImLo;
+	double spanRe;
+	double spanIm;
+	int width;
+	int height;
+};
+
+/*
+ * Iterates the Mandelbrot series in double-double precision for every pixel
+ * of row y of the viewport.
+ *
+ * Arguments:
+ *	view - The viewport that is rendered
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *	y - Index of the row
+ *	iterations - Array of view->width ints that receives the (smoothed) iteration numbers
+ */
+typedef void (*escapeRowDeepFunc)(const struct DeepViewport *view, int maxIterations, int y, float *iterations);
+
+/*
+ * High-precision reference orbit of the perturbation engine, rounded to double.
+ */
+struct ReferenceOrbit {
+	double *zr;       // Folgeglieder Z_0 ... Z_{length-1}
+	double *zi;
+	int length;       // Anzahl gültiger Folgeglieder (kleiner als maxIterations wenn die Referenz entkommt)
+};
+
+// Ergebnis für Pixel, deren Abweichung von der Referenz zu ungenau geworden ist
+#define GLITCHED -1
+
+/*
+ * Iterates points given by their offset to a reference orbit (perturbation theory).
+ *
+ * Arguments:
+ *	ref - The reference orbit
+ *	dcr - Real parts of the offsets of the points to the reference
+ *	dci - Imaginary parts of the offsets of the points to the reference
+ *	count - Number of points
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *	detectGlitches - If not 0, points that lose precision get the result GLITCHED
+ *	iterations - Receives the (smoothed) iteration number of every point
+ */
+typedef void (*perturbPointsFunc)(const struct ReferenceOrbit *ref, const double *dcr, const double *dci, int count, int maxIterations, int detectGlitches, float *iterations);
+
+/*
+ * kernel.c is compiled once per instruction set and precision, every object
+ * exports its own variant of the kernel (structure-of-arrays, 4/8/16 floats or
+ * 2/4/8 doubles per register).
+ */
+void escapeRowFloat_sse(const struct Viewport *view, int maxIterations, int y, float *iterations);
+void escapeRowFloat_avx2(const struct Viewport *view, int maxIterations, int y, float *iterations);
+void escapeRowFloat_avx512(const struct Viewport *view, int maxIterations, int y, float *iterations);
+void escapeRowDouble_sse(const struct Viewport *view, int maxIterations, int y, float *iterations);
+void escapeRowDouble_avx2(const struct Viewport *view, int maxIterations, int y, float *iterations);
+void escapeRowDouble_avx512(const struct Viewport *view, int maxIterations, int y, float *iterations);
+void escapeRunFloat_sse(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void escapeRunFloat_avx2(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void escapeRunFloat_avx512(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void escapeRunDouble_sse(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void escapeRunDouble_avx2(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void escapeRunDouble_avx512(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void formulaRunFloat_sse(const struct Formula *formula, const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void formulaRunFloat_avx2(const struct Formula *formula, const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void formulaRunFloat_avx512(const struct Formula *formula, const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void formulaRunDouble_sse(const struct Formula *formula, const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void formulaRunDouble_avx2(const struct Formula *formula, const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void formulaRunDouble_avx512(const struct Formula *formula, const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, float *iterations);
+void resumeRunFloat_sse(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, const struct EscapeState *state, float *iterations);
+void resumeRunFloat_avx2(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, const struct EscapeState *state, float *iterations);
+void resumeRunFloat_avx512(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, const struct EscapeState *state, float *iterations);
+void resumeRunDouble_sse(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, const struct EscapeState *state, float *iterations);
+void resumeRunDouble_avx2(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, const struct EscapeState *state, float *iterations);
+void resumeRunDouble_avx512(const struct Viewport *view, int maxIterations, int x, int y, int stepX, int stepY, int count, const struct EscapeState *state, float *iterations);
+void escapePointsFloat_sse(const double *cr, const double *ci, int count, int maxIterations, float *iterations);
+void escapePointsFloat_avx2(const double *cr, const double *ci, int count, int maxIterations, float *iterations);
+void escapePointsFloat_avx512(const double *cr, const double *ci, int count, int maxIterations, float *iterations);
+void escapePointsDouble_sse(const double *cr, const double *ci, int count, int maxIterations, float *iterations);
+void escapePointsDouble_avx2(const double *cr, const double *ci, int count, int maxIterations, float *iterations);
+void escapePointsDouble_avx512(const double *cr, const double *ci, int count, int maxIterations, float *iterations);
+void estimatePointsFloat_sse(const double *cr, const double *ci, int count, int maxIterations, float *iterations, float *distances);
+void estimatePointsFloat_avx2(const double *cr, const double *ci, int count, int maxIterations, float *iterations, float *distances);
+void estimatePointsFloat_avx512(const double *cr, const double *ci, int count, int maxIterations, float *iterations, float *distances);
+void estimatePointsDouble_sse(const double *cr, const double *ci, int count, int maxIterations, float *iterations, float *distances);
+void estimatePointsDouble_avx2(const double *cr, const double *ci, int count, int maxIterations, float *iterations, float *distances);
+void estimatePointsDouble_avx512(const double *cr, const double *ci, int count, int maxIterations, float *iterations, float *distances);
+void escapeRowDoubleDouble_sse(const struct DeepViewport *view, int maxIterations, int y, float *iterations);
+void escapeRowDoubleDouble_avx2(const struct DeepViewport *view, int maxIterations, int y, float *iterations);
+void escapeRowDoubleDouble_avx512(const struct DeepViewport *view, int maxIterations, int y, float *iterations);
+void perturbPointsDouble_sse(const struct ReferenceOrbit *ref, const double *dcr, const double *dci, int count, int maxIterations, int detectGlitches, float *iterations);
+void perturbPointsDouble_avx2(const struct ReferenceOrbit *ref, const double *dcr, const double *dci, int count, int maxIterations, int detectGlitches, float *iterations);
+void perturbPointsDouble_avx512(const struct ReferenceOrbit *ref, const double *dcr, const double *dci, int count, int maxIterations, int detectGlitches, float *iterations);
+
+/*
+ * The kernels for one instruction set.
+ */
+struct KernelSet {
+	const char *name;
+	escapeRowFunc escapeRowFloat;
+	escapeRowFunc escapeRowDouble;
+	escapeRunFunc escapeRunFloat;
+	escapeRunFunc escapeRunDouble;
+	formulaRunFunc formulaRunFloat;
+	formulaRunFunc formulaRunDouble;
+	resumeRunFunc resumeRunFloat;
+	resumeRunFunc resumeRunDouble;
+	escapePointsFunc escapePointsFloat;
+	escapePointsFunc escapePointsDouble;
+	estimatePointsFunc estimatePointsFloat;
+	estimatePointsFunc estimatePointsDouble;
+	escapeRowDeepFunc escapeRowDoubleDouble;
+	perturbPointsFunc perturbPoints;
+};
+
+/*
+ * Returns the kernels for the widest instruction set the CPU supports. The
+ * environment variable MANDELBROT_ISA (sse, avx2 or avx512) restricts the
+ * choice, e.g. for benchmarks; other values are reported and ignored. The
+ * choice is made once and is safe to query from several threads.
+ */
+const struct KernelSet *
+selectKernels(void);
+
+#endif /* KERNEL_HEADER */
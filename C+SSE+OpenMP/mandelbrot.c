@@ -15,211 +15,1364 @@
  */
 #include "mandelbrot.h"
 #include "stdio.h"
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
 #include <xmmintrin.h> // SSE 1
 #include <emmintrin.h> // SSE 2
 #include <pmmintrin.h> // SSE 3
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#include <time.h>
+#endif
+
+#include "kernel.h"
+#include "perturbation.h"
+#include "subdivision.h"
+#include "scheduler.h"
+#include "costmap.h"
+
+// Kacheln werden höchstens bis auf diese Kantenlänge geteilt
+#define MIN_SPLIT_SIZE 8
+
+// Einträge der Farbtabelle, auf die eine benutzerdefinierte Palette gestreckt wird
+#define PALETTE_SIZE 4096
+
+// Histogramme pro Thread für den Histogrammausgleich
+#define HISTOGRAM_COPIES 4
+
+// Höchstens so viele Stufen hat ein Histogramm (sonst wüchse der Speicher mit Threads * maxIterations),
+// bei mehr Iterationen behält die untere Hälfte eine Stufe pro Iteration, dort liegen die meisten
+// Pixel, die obere Hälfte fasst die übrigen Iterationszahlen gleichmäßig zusammen
+#define HISTOGRAM_BINS 4096
+
+// Pixel, die für den Histogrammausgleich auf einmal umgerechnet werden
+#define EQUALIZE_CHUNK 256
+
+// Benutzerdefinierte Palette, ein Pixel pro Eintrag (Byte 0 rot, Byte 3 frei); NULL für das YUV-Farbschema
+static uint32_t *palette = NULL;
+
+// Verschiebung der Farben als Anteil von maxIterations, für Farbzyklen
+static float colorOffset = 0;
+
+// Histogrammausgleich in colorizeMandelbrot und antialiasMandelbrot
+static int equalization = 0;
+
+// Kachelgröße, mit der iterateMandelbrot die Arbeit auf die Threads verteilt
+static int schedulerTileWidth = DEFAULT_TILE_WIDTH;
+static int schedulerTileHeight = DEFAULT_TILE_HEIGHT;
+
+// Kantenantialiasing von generateMandelbrot: Raster der Unterabtastungen pro Achse (1 für aus) und Schwelle
+static int antialiasGrid = 1;
+static float antialiasThreshold = DEFAULT_ANTIALIAS_THRESHOLD;
+
+// Formel von iterateMandelbrotTile
+static struct Formula formula = {FORMULA_MANDELBROT, 0, 0};
+
+// Laufzeiten des letzten Bildes von iterateMandelbrot, bestimmen die Kacheln des nächsten
+static struct CostMap costMap;
 
 /*
- * Multipliziert zwei komplexe Zahlen mit zwei komplexen Zahlen
+ * Ein Ausschnitt, der in Kacheln iteriert wird
+ */
+struct TiledView {
+    complex double upperLeft;
+    complex double lowerRight;
+    int maxIterations;
+    int width;
+    int height;
+    const struct Tile *tiles;
+    double *durations;    // gemessene Laufzeit jeder Kachel
+    float *iterations;
+    struct EscapeState state;  // Zustand jedes Pixels, state.iteration ist NULL wenn von vorne iteriert wird
+};
+
+/*
+ * Berechnet die Farben von vier Pixeln im YUV-Farbschema. Rechnet in der gleichen Reihenfolge wie
+ * die frühere Matrix mit horizontalen Summen, die Farben sind also bitgleich.
  *
  * Arguments:
- *  a - die beiden linken Faktoren
- *  b - die beiden rechten Faktoren
- * 
+ *  index - (Geglättete) Iterationszahlen der Pixel
+ *  max - maxIterations in jedem Lane
+ *
  * Returns:
- *  Die beiden Produkte
- */
-__attribute__ ((hot)) static inline __m128 complex_mul (__m128 a, __m128 b)
-{
-	// Registerinhalt:
-	// a = [ imag_2 | real_2 | imag | real ]
-	// b = [ imag_2 | real_2 | imag | real ]
-	
-	// Zuerst aus a [ a_real2 | a_real2 | a_real | a_real ] machen (_mm_moveldup_ps)
-	// dann mit b multiplizieren (_mm_mul_ps)
-	// heraus kommt: [ a_real2 * b_imag2 | a_real2 * b_real2 | a_real * b_imag | a_real * b_real ]
-	
-	// Aus a [ a_imag2 | a_imag2 | a_imag | a_imag ] machen (_mm_movehdup_ps)
-	// dann mit [ b_real2 | b_imag2 | b_real | b_imag ] multiplizieren, welches aus b geshuffled wird
-	// heraus kommt: [ a_imag2 * b_real2 | a_imag2 * b_imag2 | a_imag * b_real | a_imag * b_imag ]
-	
-	// Die beiden Teilergebnisse werden dann mit addsub verrechnet (0 und 2 werden subtrahiert, 1 und 3 werden addiert
-	
-	return _mm_addsub_ps( _mm_mul_ps(_mm_moveldup_ps(a), b),
-						  _mm_mul_ps(_mm_movehdup_ps(a), _mm_shuffle_ps(b,b, _MM_SHUFFLE(2, 3, 0, 1))));
-}
-
-/*
- * Berechnet die Quadrate der Beträge von zwei komplexen Zahlen
+ *  Die Farben als ein Pixel pro 32 Bit (Byte 0 rot, Byte 3 frei)
+ */
+__attribute__ ((hot)) static inline __m128i
+yuvColors(__m128 index, __m128 max)
+{
+	// Y ist konstant, U und V hängen von index / maxIterations ab
+	const __m128 y255 = _mm_mul_ps(_mm_set1_ps(255.0f), _mm_set1_ps(0.2f));
+	__m128 u = _mm_add_ps(_mm_set1_ps(-1.0f), _mm_div_ps(_mm_mul_ps(_mm_set1_ps(2.0f), index), max));
+	__m128 v = _mm_add_ps(_mm_set1_ps(0.5f), _mm_div_ps(_mm_sub_ps(_mm_setzero_ps(), index), max));
+
+	// YUV -> RGB, auf [0;255] skaliert
+	__m128 red = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(1.28033f*255.0f), v), y255);
+	__m128 green = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-0.38059f*255.0f), v),
+	                          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-0.21482f*255.0f), u), y255));
+	__m128 blue = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.12782f*255.0f), u), y255);
+
+	// Wie bei der Zuweisung float -> unsigned char zählt das niedrigste Byte der abgeschnittenen Zahl
+	const __m128i byte = _mm_set1_epi32(0xFF);
+	__m128i r = _mm_and_si128(_mm_cvttps_epi32(red), byte);
+	__m128i g = _mm_and_si128(_mm_cvttps_epi32(green), byte);
+	__m128i b = _mm_and_si128(_mm_cvttps_epi32(blue), byte);
+	return _mm_or_si128(r, _mm_or_si128(_mm_slli_epi32(g, 8), _mm_slli_epi32(b, 16)));
+}
+
+/*
+ * Liest die Farben von vier Pixeln aus der benutzerdefinierten Palette
  *
  * Arguments:
- *  c - die komplexen Zahlen
- *  f - der Pointer in dem das Quadrat des Betrages der unteren komplexen Zahl abgelegt wird
- *  g - der Pointer in dem das Quadrat des Betrages der oberen komplexen Zahl abgelegt wird
- * 
+ *  index - (Geglättete) Iterationszahlen der Pixel
+ *  max - maxIterations in jedem Lane
+ *
  * Returns:
- *  Nichts
+ *  Die Farben als ein Pixel pro 32 Bit (Byte 0 rot, Byte 3 frei)
  */
-__attribute__ ((hot)) static inline void complex_abs_sqr (__m128 c, float* f, float* g)
+__attribute__ ((hot)) static inline __m128i
+paletteColors(__m128 index, __m128 max)
 {
-	__m128 m;
-	
-	m = _mm_mul_ps(c,c);               // vertikale Multiplikation, d.h. quadrieren [ imag2 | real2 | imag | real ] -> [ imag2*imag2 | real2*real2 | imag*imag | real*real ]
-	m = _mm_hadd_ps(m,m);              // horizontale Addition [ imag2*imag2 | real2*real2 | imag*imag | real*real ] -> [ imag2*imag2+real2*real2 | imag*imag+real*real | imag2*imag2+real2*real2 | imag*imag+real*real ]
-	_mm_store_ss(f, m);				   // unterstes Element in f speichern (imag*imag+real*real)
-	_mm_store_ss(g, _mm_shuffle_ps(m,m, _MM_SHUFFLE(3,2,0,1))); // zweites Element in g speichern (imag2*imag2+real2*real2)
-}
+	// Die Palette reicht von 0 bis maxIterations, wie das YUV-Farbschema
+	__m128 position = _mm_mul_ps(_mm_div_ps(index, max), _mm_set1_ps((float)PALETTE_SIZE));
+	position = _mm_min_ps(_mm_max_ps(position, _mm_setzero_ps()), _mm_set1_ps((float)(PALETTE_SIZE - 1)));
 
-__m128 rgb_p, rgb_r, rgb_g, rgb_b;
+	int entry[4] __attribute__ ((aligned(16)));
+	_mm_store_si128((__m128i *)entry, _mm_cvttps_epi32(position));
+	return _mm_set_epi32(palette[entry[3]], palette[entry[2]], palette[entry[1]], palette[entry[0]]);
+}
 
 /*
- * Calculates a color mapping for a given iteration number by exploiting the
- * YUV color space. Returns the color as 8-bit unsigned char per channel (RGB).
+ * Anzahl der Stufen des Histogrammausgleichs
  *
  * Arguments:
- *	index - Number of iterations that resulted from iterating the Mandelbrot series.
- *	maxIterations - Parameter that was also used for series iteration.
+ *  maxIterations - Parameter, der auch für die Iteration verwendet wurde
  *
  * Returns:
- *	The associated color as an array of 3 8-bit unsigned char values.
+ *  maxIterations, aber höchstens HISTOGRAM_BINS
  */
-__attribute__ ((hot)) static inline void 
-colorMapYUV(int index, int maxIterations, unsigned char* color)
+static inline int
+histogramBins(int maxIterations)
 {
-	// Wenn die komplexe Zahl Teil der Mandelbrotmenge ist, wird sie schwarz eingefärbt
-	if (index == maxIterations)
+	return maxIterations < HISTOGRAM_BINS ? maxIterations : HISTOGRAM_BINS;
+}
+
+/*
+ * Iterationszahl, bis zu der jede Iterationszahl eine eigene Stufe hat
+ *
+ * Arguments:
+ *  maxIterations - Parameter, der auch für die Iteration verwendet wurde
+ */
+static inline int
+exactBins(int maxIterations)
+{
+	return maxIterations <= HISTOGRAM_BINS ? maxIterations : HISTOGRAM_BINS / 2;
+}
+
+/*
+ * Faktor von einer Iterationszahl oberhalb von exactBins auf ihre Stufe
+ *
+ * Arguments:
+ *  maxIterations - Parameter, der auch für die Iteration verwendet wurde
+ */
+static inline float
+binScale(int maxIterations)
+{
+	int exact = exactBins(maxIterations);
+	return maxIterations > exact ? (float)(histogramBins(maxIterations) - exact) / (maxIterations - exact) : 1.0f;
+}
+
+/*
+ * Bildet (geglättete) Iterationszahlen auf die Stufen des Histogrammausgleichs ab,
+ * zwischen zwei ganzen Zahlen wird linear überblendet, damit die Glättung erhalten bleibt
+ *
+ * Arguments:
+ *  iterations - (Geglättete) Iterationszahlen der Pixel
+ *  count - Anzahl der Pixel
+ *  maxIterations - Parameter, der auch für die Iteration verwendet wurde
+ *  levels - Die Stufen aus equalizeIterations
+ *  equalized - Erhält die ausgeglichenen Werte, maxIterations nur für Punkte der Menge
+ */
+__attribute__ ((hot)) static void
+equalizeRow(const float *iterations, int count, int maxIterations, const float *levels, float *equalized)
+{
+	const int bins = histogramBins(maxIterations);
+	const __m128 max = _mm_set1_ps((float)maxIterations);
+	const __m128 exact = _mm_set1_ps((float)exactBins(maxIterations));
+	const __m128 scale = _mm_set1_ps(binScale(maxIterations));
+	const __m128 top = _mm_set1_ps((float)(bins - 1));
+	const __m128 belowMax = _mm_set1_ps(nextafterf((float)maxIterations, 0));
+
+	for (int p = 0; p < count; p += 4)
 	{
-		color[0] = 0;
-		color[1] = 0;
-		color[2] = 0;
-		return;
+		float rest[4] = { maxIterations, maxIterations, maxIterations, maxIterations };
+		__m128 index;
+		if (p + 4 <= count)
+			index = _mm_loadu_ps(iterations + p);
+		else
+		{
+			memcpy(rest, iterations + p, (count - p) * sizeof(float));
+			index = _mm_loadu_ps(rest);
+		}
+
+		// Der Anteil zwischen den Stufen ist für Punkte der Menge höchstens 1
+		__m128 inside = _mm_cmpeq_ps(index, max);
+		index = _mm_max_ps(index, _mm_setzero_ps());
+		index = _mm_add_ps(_mm_min_ps(index, exact), _mm_mul_ps(_mm_max_ps(_mm_sub_ps(index, exact), _mm_setzero_ps()), scale));
+		__m128i bin = _mm_cvttps_epi32(_mm_min_ps(index, top));
+		__m128 fraction = _mm_min_ps(_mm_sub_ps(index, _mm_cvtepi32_ps(bin)), _mm_set1_ps(1.0f));
+
+		// Die Stufen aus den Registern heraus laden, über den Speicher bremst das Weiterleiten
+		int e0 = _mm_cvtsi128_si32(bin);
+		int e1 = _mm_cvtsi128_si32(_mm_shuffle_epi32(bin, 1));
+		int e2 = _mm_cvtsi128_si32(_mm_shuffle_epi32(bin, 2));
+		int e3 = _mm_cvtsi128_si32(_mm_shuffle_epi32(bin, 3));
+		__m128 low = _mm_set_ps(levels[e3], levels[e2], levels[e1], levels[e0]);
+		__m128 high = _mm_set_ps(levels[e3 + 1], levels[e2 + 1], levels[e1 + 1], levels[e0 + 1]);
+		__m128 level = _mm_add_ps(low, _mm_mul_ps(fraction, _mm_sub_ps(high, low)));
+
+		// Sind die obersten Stufen leer, erreichen auch Pixel außerhalb der Menge maxIterations
+		level = _mm_min_ps(level, belowMax);
+		level = _mm_or_ps(_mm_and_ps(inside, max), _mm_andnot_ps(inside, level));
+
+		if (p + 4 <= count)
+			_mm_storeu_ps(equalized + p, level);
+		else
+		{
+			_mm_storeu_ps(rest, level);
+			memcpy(equalized + p, rest, (count - p) * sizeof(float));
+		}
 	}
-	
-	// Farbschema anwenden
-	__m128 rgb_c;
-	__m128 i_maxi = _mm_set_ps(0.0f, 2.0f * (float)index / (float)maxIterations, -(float)index / (float)maxIterations, 0.0f);
-	rgb_c = _mm_add_ps(rgb_p, i_maxi);
-	// rgb_c enthält jetzt YUV
-	
-	// Mit Hilfe der globalen Konvertierungsmatrix den benötigten Anteil von Y, U und V pro Farbe ausrechnen
-	__m128 red = _mm_mul_ps(rgb_r, rgb_c);
-	__m128 green = _mm_mul_ps(rgb_g, rgb_c);
-	__m128 blue = _mm_mul_ps(rgb_b, rgb_c);
-	
-	// Die Anteile aufsummieren
-	red = _mm_hadd_ps(red,red);
-	red = _mm_hadd_ps(red,red);
-	green = _mm_hadd_ps(green,green);
-	green = _mm_hadd_ps(green,green);
-	blue = _mm_hadd_ps(blue,blue);
-	blue = _mm_hadd_ps(blue,blue);
-	
-	// RGB-Werte auslesen und abspeichern
-	float f __attribute__ ((aligned(16)));
-	_mm_store_ss(&f, red);
-	color[0] = f;
-	_mm_store_ss(&f, green);
-	color[1] = f;
-	_mm_store_ss(&f, blue);
-	color[2] = f;
-}
-
-// Der Logarithmus ist langsam, daher wird log(2) vorberechnet
-float logof2 = 0.6931471806;
-
-/*
- * Executes the complex series for a given parameter c for up to maxIterations
- * and saves the last series component in last.
+}
+
+/*
+ * Ermittelt die Stufen des Histogrammausgleichs: pro Thread ein Histogramm der
+ * ganzzahligen Iterationszahlen außerhalb der Menge, die Reduktion der Histogramme
+ * (parallel über die Stufen) und zuletzt die Präfixsumme
  *
  * Arguments:
- *  c - Additive component (complex number) for Mandelbrot series.
- *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
- *	last - Pointer to a complex float number that can be used for storing the last component in a series - useful for color mapping
+ *  iterations - (Geglättete) Iterationszahlen der Pixel
+ *  count - Anzahl der Pixel
+ *  maxIterations - Parameter, der auch für die Iteration verwendet wurde
  *
  * Returns:
- *	The number of iterations that were executed before the series escaped our
- *	circle or - if the point is part of the Mandelbrot set a special
- *	(user-defined) value.
- */
-__attribute__ ((hot)) static inline void
-testEscapeSeriesForPoint(__m128 c, int maxIterations, int* it1, int* it2)
-{
-	// Statt den Betrag der komplexen Zahl mit dem Radius zu vergleichen,
-	// vergleichen wir das Quadrat des Betrags der komplexen Zahl mit dem Quadrat des Radius.
-	// Dadurch sparen wir uns das Wurzelziehen in jeder Iteration (und Wurzeln sind langsam!)
-	float r  = RADIUS*RADIUS;
-	
-	// Zwischenspeicher für die Quadrate der Beträge der komplexen Zahlen
-	float f = 0;
-	float g = 0;
-	
-    __m128 z = _mm_setzero_ps();
-	
-	// Die Iterationszähler
-	int iteration1 = 0;
-	int iteration2  = 0;
-	
-	// Hier merken wir uns ob wir mit einer Zahl schon fertig sind
-	int it1_done  = 0;
-	int it2_done  = 0;
-	
-	// Variablen für die "echten" Beträge fürs smooth coloring.
-	float f_sqrt=0, g_sqrt=0;
-	
-	while (iteration1 < maxIterations && iteration2 < maxIterations)
+ *  histogramBins(maxIterations) + 1 Stufen, levels[k] ist maxIterations mal der Anteil
+ *  der Pixel außerhalb der Menge unterhalb von Stufe k; NULL wenn der Speicher fehlt
+ */
+static float *
+equalizeIterations(const float *iterations, size_t count, int maxIterations)
+{
+    int bins = histogramBins(maxIterations);
+    int exact = exactBins(maxIterations);
+    float scale = binScale(maxIterations);
+
+    // Benachbarte Pixel landen oft in derselben Stufe, deshalb zählt jeder Thread reihum in
+    // HISTOGRAM_COPIES Histogramme, damit nicht jedes Erhöhen auf das vorige warten muss
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+#else
+    int threads = 1;
+#endif
+    size_t histogramCount = (size_t)threads * HISTOGRAM_COPIES;
+    uint32_t *histograms = calloc(histogramCount * bins, sizeof(uint32_t));
+    uint64_t *sums = malloc(bins * sizeof(uint64_t));
+    float *levels = malloc((bins + 1) * sizeof(float));
+    if(histograms == NULL || sums == NULL || levels == NULL) {
+        printf("Not enough memory for histogram equalisation, using the plain colouring...\n");
+        free(histograms);
+        free(sums);
+        free(levels);
+        return NULL;
+    }
+
+    #pragma omp parallel
+    {
+#ifdef _OPENMP
+        int thread = omp_get_thread_num();
+#else
+        int thread = 0;
+#endif
+        uint32_t *histogram = histograms + (size_t)thread * HISTOGRAM_COPIES * bins;
+
+        // 32 Bit reichen, ein Zähler läuft erst nach 2^32 * HISTOGRAM_COPIES Pixeln eines Threads über
+        #pragma omp for schedule(static)
+        for(size_t p = 0; p < count; p++) {
+            float v = iterations[p];
+            if(v < maxIterations) {
+                int bin = v > exact ? exact + (int)((v - exact) * scale) : (v > 0 ? (int)v : 0);
+                histogram[(p % HISTOGRAM_COPIES) * bins + (bin < bins ? bin : bins - 1)]++;
+            }
+        }
+
+        // Jede Stufe wird von genau einem Thread über alle Histogramme summiert
+        #pragma omp for schedule(static)
+        for(int k = 0; k < bins; k++) {
+            uint64_t sum = 0;
+            for(size_t h = 0; h < histogramCount; h++) {
+                sum += histograms[h * bins + k];
+            }
+            sums[k] = sum;
+        }
+    }
+    free(histograms);
+
+    uint64_t total = 0;
+    for(int k = 0; k < bins; k++) {
+        total += sums[k];
+    }
+
+    uint64_t below = 0;
+    for(int k = 0; k <= bins; k++) {
+        levels[k] = total ? (float)((double)below / total * maxIterations) : 0;
+        if(k < bins) {
+            below += sums[k];
+        }
+    }
+
+    free(sums);
+    return levels;
+}
+
+/*
+ * Colours a row of iteration values, four pixels per step: the colours are
+ * computed in one register (YUV scheme or palette lookup) and written with an
+ * 8-byte and a 4-byte store per four pixels.
+ *
+ * Arguments:
+ *	iterations - (Smoothed) iteration numbers of the pixels
+ *	count - Number of pixels
+ *	maxIterations - Parameter that was also used for series iteration, pixels with this value are black
+ *	levels - Levels from equalizeIterations for histogram equalisation, NULL for the plain ramp
+ *	rgb - Receives 3 8-bit values (RGB) per pixel
+ */
+__attribute__ ((hot)) static void
+colorizeRow(const float *iterations, int count, int maxIterations, const float *levels, unsigned char *rgb)
+{
+	// Abschnittsweise erst ausgleichen, dann einfärben; in einer Schleife verdrängen die
+	// Ladebefehle der Stufen die Rechnung der Farben
+	if (levels)
 	{
-		// Quadrate der Beträge berechnen
-		complex_abs_sqr(z, &f, &g);
-		
-		if ((f > r) && (g > r)) {
-			// Wenn beide Zahlen den Radius verlassen haben müssen wir nicht mehr weiterrechnen
-			break;
-		} else if (f>r && !it1_done) {
-			it1_done = -1;    // Mit der unteren Zahl sind wir fertig
-			f_sqrt = sqrt(f); // Den "echten" Betrag berechnen, der wird noch für das smooth-coloring gebraucht
-			
-			// Wenn wir mit einer Zahl fertig sind wird die andere dupliziert und überschreibt erstere - ansonsten könnte erstere überlaufen, und das gäbe Probleme!
-			z = _mm_shuffle_ps(z,z, _MM_SHUFFLE(3,2,3,2));
-		} else if (g>r && !it2_done) {
-			it2_done = -1;    // Mit der oberen Zahl sind wir fertig
-			g_sqrt = sqrt(g); // Den "echten" Betrag berechnen, der wird noch für das smooth-coloring gebraucht
-			
-			// Wenn wir mit einer Zahl fertig sind wird die andere dupliziert und überschreibt erstere - ansonsten könnte erstere überlaufen, und das gäbe Probleme!
-			z = _mm_shuffle_ps(z,z, _MM_SHUFFLE(1,0,1,0));
+		float equalized[EQUALIZE_CHUNK];
+		for (int c = 0; c < count; c += EQUALIZE_CHUNK)
+		{
+			int n = count - c < EQUALIZE_CHUNK ? count - c : EQUALIZE_CHUNK;
+			equalizeRow(iterations + c, n, maxIterations, levels, equalized);
+			colorizeRow(equalized, n, maxIterations, NULL, rgb + (size_t)c * 3);
 		}
-		
-		// Wenn wir mit beiden Zahlen fertig sind können wir ja aufhören
-		if (it1_done && it2_done) break;
-			
-		// Mandelbrotfolge für n+1 berechnen
-		z = _mm_add_ps(complex_mul(z,z), c);
-		
-		// Wenn wir mit dieser Zahl noch nicht fertig sind inkrementieren wir die Iterationsvariable
-		if (!it1_done)
-			iteration1++;
-		
-		// Wenn wir mit dieser Zahl noch nicht fertig sind inkrementieren wir die Iterationsvariable
-		if (!it2_done)
-			iteration2++;
-	}
-	
-	// Wenn die untere komplexe Zahl nicht in der Mandelbrot-Menge liegt, smooth coloring anwenden
-	if (iteration1 < maxIterations)
-	{
-		if (!it1_done) f_sqrt = sqrt(f);
-		iteration1 += 1.0f - (log(log(f_sqrt) / logof2) / logof2);
+		return;
 	}
-	
-	// Wenn die obere komplexe Zahl nicht in der Mandelbrot-Menge liegt, smooth coloring anwenden
-	if (iteration2 < maxIterations)
+
+	const __m128 max = _mm_set1_ps((float)maxIterations);
+	const float shift = colorOffset * maxIterations;
+	const __m128 offset = _mm_set1_ps(shift);
+
+	for (int p = 0; p < count; p += 4)
 	{
-		if (!it2_done) g_sqrt = sqrt(g);
-		iteration2 += 1.0f - (log(log(g_sqrt) / logof2) / logof2);
+		// Der Rest einer Zeile wird mit Punkten der Menge aufgefüllt
+		__m128 index;
+		if (p + 4 <= count)
+			index = _mm_loadu_ps(iterations + p);
+		else
+		{
+			float rest[4] = { maxIterations, maxIterations, maxIterations, maxIterations };
+			memcpy(rest, iterations + p, (count - p) * sizeof(float));
+			index = _mm_loadu_ps(rest);
+		}
+
+		// Wenn die komplexe Zahl Teil der Mandelbrotmenge ist, wird sie schwarz eingefärbt
+		__m128 inside = _mm_cmpeq_ps(index, max);
+		if (shift != 0)
+		{
+			// Verschobene Werte laufen über maxIterations hinaus wieder bei 0 weiter
+			index = _mm_add_ps(index, offset);
+			index = _mm_sub_ps(index, _mm_and_ps(_mm_cmpge_ps(index, max), max));
+		}
+		__m128i colors = palette ? paletteColors(index, max) : yuvColors(index, max);
+		colors = _mm_andnot_si128(_mm_castps_si128(inside), colors);
+
+		// Die vier Pixel zu 12 Bytes zusammenschieben
+		uint64_t low = _mm_cvtsi128_si64(colors);
+		uint64_t high = _mm_cvtsi128_si64(_mm_unpackhi_epi64(colors, colors));
+		uint64_t first = (low & 0xFFFFFF) | ((low >> 32) & 0xFFFFFF) << 24 | (high & 0xFFFF) << 48;
+		uint32_t second = (uint32_t)((high >> 16) & 0xFF) | (uint32_t)((high >> 32) & 0xFFFFFF) << 8;
+
+		unsigned char *pixel = rgb + (size_t)p * 3;
+		if (p + 4 <= count)
+		{
+			memcpy(pixel, &first, 8);
+			memcpy(pixel + 8, &second, 4);
+		}
+		else
+		{
+			unsigned char bytes[12];
+			memcpy(bytes, &first, 8);
+			memcpy(bytes + 8, &second, 4);
+			memcpy(pixel, bytes, (count - p) * 3);
+		}
 	}
-	
-	// Iterationen zurückgeben
-	*it1 = iteration1;
-	*it2 = iteration2;
+}
+
+/*
+ * Checks whether a floating point type with the given machine epsilon can still
+ * resolve the pixels of a viewport: the distance between two pixels has to be at
+ * least PRECISION_MARGIN steps of the type at the magnitude of the coordinates,
+ * otherwise neighbouring pixels collapse into blocks.
+ */
+static int
+resolvesPixels(
+    complex double upperLeft,
+    complex double lowerRight,
+    int width,
+    int height,
+    double epsilon)
+{
+    double dx = fabs(creal(lowerRight) - creal(upperLeft)) / width;
+    double dy = fabs(cimag(lowerRight) - cimag(upperLeft)) / height;
+    double magnitude = fmax(fmax(fabs(creal(upperLeft)), fabs(cimag(upperLeft))),
+                            fmax(fabs(creal(lowerRight)), fabs(cimag(lowerRight))));
+
+    return fmin(dx, dy) >= PRECISION_MARGIN * epsilon * fmax(magnitude, 1.0);
+}
+
+int
+needsPerturbation(
+    complex double upperLeft,
+    complex double lowerRight,
+    int width,
+    int height)
+{
+    return !resolvesPixels(upperLeft, lowerRight, width, height, DBL_EPSILON);
+}
+
+const char *
+mandelbrotKernelName(void)
+{
+	return selectKernels()->name;
+}
+
+/*
+ * Iterates the Mandelbrot series for every pixel of a tile of a view.
+ */
+void
+iterateMandelbrotTile(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int tileX,
+    int tileY,
+    int tileWidth,
+    int tileHeight,
+    float *iterations,
+    size_t stride)
+{
+    const struct KernelSet *kernels = selectKernels();
+
+    // Die Genauigkeit hängt vom ganzen Ausschnitt ab, damit alle Kacheln zusammenpassen
+    int useFloat = resolvesPixels(upperLeft, lowerRight, width, height, FLT_EPSILON);
+    escapeRunFunc escapeRun = useFloat ? kernels->escapeRunFloat : kernels->escapeRunDouble;
+    formulaRunFunc formulaRun = useFloat ? kernels->formulaRunFloat : kernels->formulaRunDouble;
+    struct Viewport view = {
+        creal(upperLeft), cimag(upperLeft),
+        creal(lowerRight), cimag(lowerRight),
+        width, height
+    };
+
+    for(int y = 0; y < tileHeight; y++) {
+        if(formula.type == FORMULA_MANDELBROT) {
+            escapeRun(&view, maxIterations, tileX, tileY + y, 1, 0, tileWidth, iterations + y * stride);
+        } else {
+            formulaRun(&formula, &view, maxIterations, tileX, tileY + y, 1, 0, tileWidth, iterations + y * stride);
+        }
+    }
+}
+
+/*
+ * Renders a tile of a view into a caller-provided buffer.
+ */
+void
+renderMandelbrotTile(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int tileX,
+    int tileY,
+    int tileWidth,
+    int tileHeight,
+    unsigned char *image,
+    size_t stride)
+{
+    // Zeilenweise iterieren und einfärben, so braucht es nur den Zwischenspeicher für eine Zeile
+    float *row = malloc(tileWidth * sizeof(float));
+
+    for(int y = 0; y < tileHeight; y++) {
+        iterateMandelbrotTile(upperLeft, lowerRight, maxIterations, width, height, tileX, tileY + y, tileWidth, 1, row, tileWidth);
+        colorizeRow(row, tileWidth, maxIterations, NULL, image + y * stride);
+    }
+
+    free(row);
+}
+
+/*
+ * Renders a band of rows of a view, the rows are shared among the threads.
+ */
+void
+renderMandelbrotBand(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int firstRow,
+    int rows,
+    unsigned char *image,
+    ptrdiff_t stride)
+{
+    // Jede Zeile einzeln, so darf der Abstand der Zeilen auch negativ sein
+    #pragma omp parallel for schedule(dynamic)
+    for(int y = 0; y < rows; y++) {
+        renderMandelbrotTile(upperLeft, lowerRight, maxIterations, width, height, 0, firstRow + y, width, 1,
+                             image + y * stride, (size_t)width * 3);
+    }
+}
+
+/*
+ * Wanduhrzeit in Sekunden, für die Kostenkarte
+ */
+static double
+wallTime(void)
+{
+#ifdef _OPENMP
+	return omp_get_wtime();
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+ * Setzt die Iteration der Pixel einer Kachel aus ihrem Zustand fort
+ *
+ * Arguments:
+ *  view - Der Ausschnitt mit dem Zustand aller Pixel
+ *  tile - Die Kachel
+ */
+static void
+resumeTile(const struct TiledView *view, const struct Tile *tile)
+{
+    const struct KernelSet *kernels = selectKernels();
+
+    // Gleiche Wahl der Genauigkeit wie in iterateMandelbrotTile, der Zustand gehört zu ihr
+    resumeRunFunc resumeRun = resolvesPixels(view->upperLeft, view->lowerRight, view->width, view->height, FLT_EPSILON)
+                            ? kernels->resumeRunFloat : kernels->resumeRunDouble;
+    struct Viewport viewport = {
+        creal(view->upperLeft), cimag(view->upperLeft),
+        creal(view->lowerRight), cimag(view->lowerRight),
+        view->width, view->height
+    };
+
+    for(int y = 0; y < tile->height; y++) {
+        size_t offset = (size_t)(tile->y + y) * view->width + tile->x;
+        struct EscapeState row = {
+            view->state.zr + offset, view->state.zi + offset, view->state.iteration + offset
+        };
+        resumeRun(&viewport, view->maxIterations, tile->x, tile->y + y, 1, 0, tile->width, &row, view->iterations + offset);
+    }
+}
+
+/*
+ * Iteriert eine Kachel eines Ausschnitts, wird vom Scheduler aufgerufen
+ *
+ * Arguments:
+ *  tile - Index der Kachel in view->tiles
+ *  data - Der Ausschnitt (struct TiledView)
+ */
+static void
+iterateTile(int tile, void *data)
+{
+    const struct TiledView *view = data;
+    const struct Tile *t = &view->tiles[tile];
+
+    double start = wallTime();
+    if(view->state.iteration) {
+        resumeTile(view, t);
+    } else {
+        iterateMandelbrotTile(view->upperLeft, view->lowerRight, view->maxIterations, view->width, view->height,
+                              t->x, t->y, t->width, t->height, view->iterations + (size_t)t->y * view->width + t->x, view->width);
+    }
+    view->durations[tile] = wallTime() - start;
+}
+
+/*
+ * Teilt einen Ausschnitt in Kacheln. Ohne Kostenkarte entsteht das normale Raster,
+ * sonst werden Kacheln, die einen zu großen Teil der erwarteten Arbeit ausmachen,
+ * solange geviertelt, bis die Threads sie gut untereinander aufteilen können.
+ *
+ * Arguments:
+ *  upperLeft, lowerRight, width, height - Der Ausschnitt
+ *  map - Die Kostenkarte oder NULL
+ *  tiles - Erhält das Array der Kacheln
+ *  costs - Erhält die geschätzten Kosten jeder Kachel, NULL ohne Kostenkarte
+ *
+ * Returns:
+ *  Anzahl der Kacheln
+ */
+static int
+planTiles(complex double upperLeft, complex double lowerRight, int width, int height,
+          const struct CostMap *map, struct Tile **tiles, double **costs)
+{
+    int tilesPerRow = (width + schedulerTileWidth - 1) / schedulerTileWidth;
+    int count = tilesPerRow * ((height + schedulerTileHeight - 1) / schedulerTileHeight);
+    int capacity = count;
+    struct Tile *t = malloc(capacity * sizeof(struct Tile));
+
+    for(int i = 0; i < count; i++) {
+        t[i].x = (i % tilesPerRow) * schedulerTileWidth;
+        t[i].y = (i / tilesPerRow) * schedulerTileHeight;
+        t[i].width = t[i].x + schedulerTileWidth < width ? schedulerTileWidth : width - t[i].x;
+        t[i].height = t[i].y + schedulerTileHeight < height ? schedulerTileHeight : height - t[i].y;
+    }
+
+    *tiles = t;
+    *costs = NULL;
+    if(map == NULL || !map->valid) {
+        return count;
+    }
+
+    double *c = malloc(capacity * sizeof(double));
+    double total = 0;
+    for(int i = 0; i < count; i++) {
+        c[i] = estimateTileCost(map, upperLeft, lowerRight, width, height, &t[i]);
+        total += c[i];
+    }
+
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+#else
+    int threads = 1;
+#endif
+    // Keine Kachel soll mehr als ein Viertel des Anteils eines Threads kosten
+    double limit = total / (4 * threads);
+
+    for(int i = 0; i < count; ) {
+        int splitX = t[i].width >= 2 * MIN_SPLIT_SIZE;
+        int splitY = t[i].height >= 2 * MIN_SPLIT_SIZE;
+        if(c[i] <= limit || (!splitX && !splitY)) {
+            i++;
+            continue;
+        }
+
+        if(count + 3 > capacity) {
+            capacity *= 2;
+            t = realloc(t, capacity * sizeof(struct Tile));
+            c = realloc(c, capacity * sizeof(double));
+        }
+
+        // In Hälften oder Viertel teilen, die erste ersetzt die Kachel und wird erneut geprüft
+        struct Tile whole = t[i];
+        int w = splitX ? whole.width / 2 : whole.width;
+        int h = splitY ? whole.height / 2 : whole.height;
+        int first = i;
+        for(int part = 0; part < 4; part++) {
+            int right = part & 1;
+            int bottom = part >> 1;
+            if((right && !splitX) || (bottom && !splitY)) {
+                continue;
+            }
+
+            int k = part == 0 ? first : count++;
+            t[k].x = whole.x + right * w;
+            t[k].y = whole.y + bottom * h;
+            t[k].width = right ? whole.width - w : w;
+            t[k].height = bottom ? whole.height - h : h;
+            c[k] = estimateTileCost(map, upperLeft, lowerRight, width, height, &t[k]);
+        }
+    }
+
+    *tiles = t;
+    *costs = c;
+    return count;
+}
+
+/*
+ * Iteriert alle Kacheln eines Ausschnitts mit allen Threads
+ *
+ * Arguments:
+ *  view - Der Ausschnitt, tiles und durations werden hier gesetzt
+ *  map - Kostenkarte, die die Kacheln bestimmt und danach die gemessenen Laufzeiten erhält, oder NULL
+ */
+static void
+iterateTiles(struct TiledView *view, struct CostMap *map)
+{
+    // Zeilen durch das Innere der Menge kosten ein Vielfaches der übrigen, daher verteilt ein
+    // Work-Stealing-Scheduler Kacheln auf die Threads. Die Laufzeiten des letzten Bildes
+    // sagen voraus, welche Kacheln teuer sind; die werden kleiner geschnitten und zuerst verteilt.
+    struct Tile *tiles;
+    double *costs;
+    int count = planTiles(view->upperLeft, view->lowerRight, view->width, view->height, map, &tiles, &costs);
+
+    view->tiles = tiles;
+    view->durations = malloc(count * sizeof(double));
+    runTiles(count, costs, iterateTile, view);
+
+    if(map) {
+        recordTileCosts(map, view->upperLeft, view->lowerRight, view->width, view->height, tiles, view->durations, count);
+    }
+
+    free(view->durations);
+    free(costs);
+    free(tiles);
+}
+
+/*
+ * Iterates the Mandelbrot series for every pixel of a view.
+ */
+float *
+iterateMandelbrot(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height)
+{
+    // Allocate iteration buffer, row-major order.
+    float *iterations = malloc((size_t)width * height * sizeof(float));
+
+    struct TiledView view = {
+        upperLeft, lowerRight, maxIterations, width, height,
+        NULL, NULL, iterations, {NULL, NULL, NULL}
+    };
+    iterateTiles(&view, &costMap);
+
+    return iterations;
+}
+
+/*
+ * Iterates a view, continuing the pixels of a previous call that are not
+ * decided yet if the view is the same.
+ */
+float *
+iterateMandelbrotResumable(
+    struct MandelbrotState *state,
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height)
+{
+    int resume = state->iterations != NULL
+              && state->upperLeft == upperLeft && state->lowerRight == lowerRight
+              && state->width == width && state->height == height
+              && state->maxIterations <= maxIterations;
+
+    if(!resume) {
+        size_t pixels = (size_t)width * height;
+
+        // Bei gleicher Größe werden die Puffer weiterverwendet, frischer Speicher kostet Seitenfehler
+        if(state->iterations == NULL || state->width != width || state->height != height) {
+            freeMandelbrotState(state);
+            state->iterations = malloc(pixels * sizeof(float));
+            state->zr = malloc(pixels * sizeof(double));
+            state->zi = malloc(pixels * sizeof(double));
+            state->iteration = malloc(pixels * sizeof(int));
+        }
+        memset(state->zr, 0, pixels * sizeof(double));
+        memset(state->zi, 0, pixels * sizeof(double));
+        memset(state->iteration, 0, pixels * sizeof(int));
+
+        state->upperLeft = upperLeft;
+        state->lowerRight = lowerRight;
+        state->width = width;
+        state->height = height;
+    }
+    state->maxIterations = maxIterations;
+
+    struct TiledView view = {
+        upperLeft, lowerRight, maxIterations, width, height,
+        NULL, NULL, state->iterations, {state->zr, state->zi, state->iteration}
+    };
+
+    // Beim Fortsetzen sind nur noch die Pixel übrig, die die alte Grenze erreicht haben, die Kostenkarte passt dann nicht
+    iterateTiles(&view, resume ? NULL : &costMap);
+
+    return state->iterations;
+}
+
+void
+freeMandelbrotState(struct MandelbrotState *state)
+{
+    free(state->iterations);
+    free(state->zr);
+    free(state->zi);
+    free(state->iteration);
+    state->iterations = NULL;
+    state->zr = NULL;
+    state->zi = NULL;
+    state->iteration = NULL;
+}
+
+void
+setMandelbrotTileSize(int width, int height)
+{
+    schedulerTileWidth = width > 0 ? width : DEFAULT_TILE_WIDTH;
+    schedulerTileHeight = height > 0 ? height : DEFAULT_TILE_HEIGHT;
+}
+
+/*
+ * Iterates a view by recursive rectangle subdivision.
+ */
+float *
+iterateMandelbrotSubdivision(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height)
+{
+    const struct KernelSet *kernels = selectKernels();
+    escapeRunFunc escapeRun = resolvesPixels(upperLeft, lowerRight, width, height, FLT_EPSILON) ? kernels->escapeRunFloat : kernels->escapeRunDouble;
+
+    struct Viewport view = {
+        creal(upperLeft), cimag(upperLeft),
+        creal(lowerRight), cimag(lowerRight),
+        width, height
+    };
+
+    float *iterations = malloc((size_t)width * height * sizeof(float));
+    iterateSubdivision(escapeRun, &view, maxIterations, iterations);
+
+    return iterations;
+}
+
+/*
+ * Iterates a view in double-double precision.
+ */
+float *
+iterateMandelbrotDoubleDouble(
+    deepfloat centerRe,
+    deepfloat centerIm,
+    double spanRe,
+    double spanIm,
+    int maxIterations,
+    int width,
+    int height)
+{
+    escapeRowDeepFunc escapeRow = selectKernels()->escapeRowDoubleDouble;
+
+    // Die Mitte wird in die Summe zweier doubles zerlegt, der zweite Teil ist der Rundungsfehler des ersten
+    double centerReHi = deepToDouble(&centerRe);
+    double centerImHi = deepToDouble(&centerIm);
+    deepfloat centerReLo = deepFromDouble(centerReHi);
+    deepfloat centerImLo = deepFromDouble(centerImHi);
+    deepSub(&centerReLo, &centerRe, &centerReLo, DEEP_LIMBS);
+    deepSub(&centerImLo, &centerIm, &centerImLo, DEEP_LIMBS);
+    struct DeepViewport view = {
+        centerReHi, deepToDouble(&centerReLo),
+        centerImHi, deepToDouble(&centerImLo),
+        spanRe, spanIm,
+        width, height
+    };
+
+    float *iterations = malloc((size_t)width * height * sizeof(float));
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int y = 0; y < height; y++) {
+        escapeRow(&view, maxIterations, y, iterations + (size_t)y * width);
+    }
+
+    return iterations;
+}
+
+/*
+ * Iterates a view with perturbation theory.
+ */
+float *
+iterateMandelbrotPerturbation(
+    deepfloat centerRe,
+    deepfloat centerIm,
+    double spanRe,
+    double spanIm,
+    int maxIterations,
+    int width,
+    int height)
+{
+    float *iterations = malloc((size_t)width * height * sizeof(float));
+    size_t glitches = iteratePerturbation(&centerRe, &centerIm, spanRe, spanIm, maxIterations, width, height, iterations);
+    if(glitches > 0) {
+        printf("%zu pixels are still glitched after the last reference and may be inaccurate\n", glitches);
+    }
+
+    return iterations;
+}
+
+/*
+ * Turns an iteration field into RGB colours.
+ */
+unsigned char *
+colorizeMandelbrot(
+    const float *iterations,
+    int maxIterations,
+    int width,
+    int height)
+{
+    // Allocate image buffer, row-major order, 3 channels.
+    unsigned char *image = malloc((size_t)height * width * 3);
+    float *levels = equalization ? equalizeIterations(iterations, (size_t)width * height, maxIterations) : NULL;
+
+    #pragma omp parallel for
+    for(int y = 0; y < height; y++) {
+        colorizeRow(iterations + (size_t)y * width, width, maxIterations, levels, image + (size_t)y * width * 3);
+    }
+
+    free(levels);
+    return image;
+}
+
+/*
+ * Pseudozufälliger Versatz einer Unterabtastung, hängt nur von Pixel und Nummer ab,
+ * damit das Bild unabhängig von der Verteilung auf die Threads ist
+ *
+ * Arguments:
+ *  x, y - Der Pixel
+ *  n - Nummer des Versatzes innerhalb des Pixels
+ *
+ * Returns:
+ *  Ein Wert in [0, 1)
+ */
+static inline double
+jitter(int x, int y, int n)
+{
+	unsigned int h = (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)n * 83492791u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return (h & 0xffffff) / 16777216.0;
+}
+
+/*
+ * Smooths the edges of a coloured view with extra samples.
+ */
+void
+antialiasMandelbrot(
+    const float *iterations,
+    unsigned char *image,
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int grid,
+    float threshold)
+{
+    if(grid < 2) {
+        return;
+    }
+
+    const struct KernelSet *kernels = selectKernels();
+
+    // Die Unterabtastungen liegen dichter als die Pixel, danach richtet sich die Genauigkeit
+    escapePointsFunc escapePoints = resolvesPixels(upperLeft, lowerRight, width * grid, height * grid, FLT_EPSILON)
+                                  ? kernels->escapePointsFloat : kernels->escapePointsDouble;
+    double dx = (creal(lowerRight) - creal(upperLeft)) / width;
+    double dy = (cimag(lowerRight) - cimag(upperLeft)) / height;
+    float limit = threshold * maxIterations;
+    int samples = grid * grid;
+
+    // Die Abtastungen werden mit denselben Stufen eingefärbt wie das Bild
+    float *levels = equalization ? equalizeIterations(iterations, (size_t)width * height, maxIterations) : NULL;
+
+    #pragma omp parallel
+    {
+        // Zusätzliche Abtastungen aller Kantenpixel einer Zeile, damit der Kernel sie gemeinsam iteriert
+        int *edges = malloc(width * sizeof(int));
+        double *cr = malloc(width * (samples - 1) * sizeof(double));
+        double *ci = malloc(width * (samples - 1) * sizeof(double));
+        float *result = malloc(width * (samples - 1) * sizeof(float));
+        unsigned char *colors = malloc(width * (samples - 1) * 3);
+
+        #pragma omp for schedule(dynamic)
+        for(int y = 0; y < height; y++) {
+            const float *row = iterations + (size_t)y * width;
+            int count = 0;
+            int n = 0;
+
+            // Kantenpixel: ein Nachbar hat eine deutlich andere (geglättete) Iterationszahl
+            for(int x = 0; x < width; x++) {
+                float v = row[x];
+                if(!((x > 0 && fabsf(v - row[x - 1]) > limit)
+                  || (x + 1 < width && fabsf(v - row[x + 1]) > limit)
+                  || (y > 0 && fabsf(v - row[x - width]) > limit)
+                  || (y + 1 < height && fabsf(v - row[x + width]) > limit))) {
+                    continue;
+                }
+
+                // Ein Punkt pro Feld eines grid x grid Rasters, zufällig im Feld verschoben. Das Feld links
+                // oben deckt der vorhandene Wert an der Ecke des Pixels ab.
+                edges[count++] = x;
+                for(int k = 1; k < samples; k++) {
+                    cr[n] = creal(upperLeft) + (x + (k % grid + jitter(x, y, 2 * k)) / grid) * dx;
+                    ci[n] = cimag(upperLeft) + (y + (k / grid + jitter(x, y, 2 * k + 1)) / grid) * dy;
+                    n++;
+                }
+            }
+
+            if(count == 0) {
+                continue;
+            }
+            escapePoints(cr, ci, n, maxIterations, result);
+            colorizeRow(result, n, maxIterations, levels, colors);
+
+            // Die Farben der Abtastungen mitteln, nicht die Iterationszahlen
+            for(int e = 0; e < count; e++) {
+                unsigned char *pixel = image + ((size_t)y * width + edges[e]) * 3;
+                int sum[3] = { pixel[0], pixel[1], pixel[2] };
+                for(int k = 0; k < samples - 1; k++) {
+                    const unsigned char *color = colors + (e * (samples - 1) + k) * 3;
+                    sum[0] += color[0];
+                    sum[1] += color[1];
+                    sum[2] += color[2];
+                }
+                for(int c = 0; c < 3; c++) {
+                    pixel[c] = (sum[c] + samples / 2) / samples;
+                }
+            }
+        }
+
+        free(colors);
+        free(result);
+        free(ci);
+        free(cr);
+        free(edges);
+    }
+
+    free(levels);
+}
+
+/*
+ * Ein Ausschnitt, dessen Abstände zur Menge kachelweise geschätzt werden
+ */
+struct DistanceView {
+    complex double upperLeft;
+    complex double lowerRight;
+    int maxIterations;
+    int width;
+    int height;
+    int tilesPerRow;
+    int fillDiscs;
+    float *distances;     // in Pixeln, negativ solange ein Pixel weder iteriert noch von einer Scheibe bedeckt ist
+};
+
+/*
+ * Füllt die Pixel einer Kachel, die in der Koebe-Scheibe um einen iterierten Pixel liegen.
+ * Die Scheibe mit einem Viertel des geschätzten Abstands liegt sicher außerhalb der Menge,
+ * jeder Pixel darin ist mindestens so weit entfernt wie vom Rand der Scheibe.
+ *
+ * Arguments:
+ *  view - Der Ausschnitt
+ *  tileX, tileY, tileWidth, tileHeight - Die Kachel, über sie hinaus wird nicht gefüllt
+ *  x, y - Mittelpunkt der Scheibe, relativ zur Kachel
+ *  radius - Radius der Scheibe in der komplexen Ebene
+ *  dx, dy - Abstand zweier Pixel
+ *  pixel - Größe eines Pixels, Einheit der Abstände
+ */
+static void
+fillDisc(const struct DistanceView *view, int tileX, int tileY, int tileWidth, int tileHeight,
+         int x, int y, double radius, double dx, double dy, double pixel)
+{
+    // Nur Pixel, die sicher ganz weiß werden, die übrigen brauchen ihre eigene Schätzung
+    double limit = DISTANCE_RAMP * pixel;
+    if(radius <= limit) {
+        return;
+    }
+
+    int rx = (int)(radius / fabs(dx));
+    int ry = (int)(radius / fabs(dy));
+    for(int j = y - ry > 0 ? -ry : -y; j <= ry && y + j < tileHeight; j++) {
+        float *row = view->distances + (size_t)(tileY + y + j) * view->width + tileX;
+        for(int i = x - rx > 0 ? -rx : -x; i <= rx && x + i < tileWidth; i++) {
+            if(row[x + i] >= 0) {
+                continue;
+            }
+            double bound = radius - hypot(i * dx, j * dy);
+            if(bound >= limit) {
+                row[x + i] = bound / pixel;
+            }
+        }
+    }
+}
+
+/*
+ * Schätzt die Abstände einer Kachel, wird vom Scheduler aufgerufen. Die Pixel werden
+ * von grob nach fein iteriert: die ersten, weit auseinander liegenden Pixel füllen
+ * mit ihren Scheiben den Großteil des Äußeren, bevor die Pixel dazwischen dran sind.
+ *
+ * Arguments:
+ *  tile - Index der Kachel, zeilenweise durchnummeriert
+ *  data - Der Ausschnitt (struct DistanceView)
+ */
+static void
+estimateTile(int tile, void *data)
+{
+    const struct DistanceView *view = data;
+    const struct KernelSet *kernels = selectKernels();
+    estimatePointsFunc estimatePoints = resolvesPixels(view->upperLeft, view->lowerRight, view->width, view->height, FLT_EPSILON)
+                                      ? kernels->estimatePointsFloat : kernels->estimatePointsDouble;
+
+    int tileX = (tile % view->tilesPerRow) * DISTANCE_TILE_SIZE;
+    int tileY = (tile / view->tilesPerRow) * DISTANCE_TILE_SIZE;
+    int tileWidth = tileX + DISTANCE_TILE_SIZE < view->width ? DISTANCE_TILE_SIZE : view->width - tileX;
+    int tileHeight = tileY + DISTANCE_TILE_SIZE < view->height ? DISTANCE_TILE_SIZE : view->height - tileY;
+
+    double dx = (creal(view->lowerRight) - creal(view->upperLeft)) / view->width;
+    double dy = (cimag(view->lowerRight) - cimag(view->upperLeft)) / view->height;
+    double pixel = fmax(fabs(dx), fabs(dy));
+
+    int pixels = tileWidth * tileHeight;
+    int *points = malloc(pixels * sizeof(int));
+    double *cr = malloc(pixels * sizeof(double));
+    double *ci = malloc(pixels * sizeof(double));
+    float *iterations = malloc(pixels * sizeof(float));
+    float *estimates = malloc(pixels * sizeof(float));
+
+    for(int step = view->fillDiscs ? DISTANCE_TILE_SIZE / 4 : 1; step >= 1; step /= 2) {
+        // Alle noch offenen Pixel dieses Rasters gemeinsam iterieren
+        int count = 0;
+        for(int y = 0; y < tileHeight; y += step) {
+            const float *row = view->distances + (size_t)(tileY + y) * view->width + tileX;
+            for(int x = 0; x < tileWidth; x += step) {
+                if(row[x] >= 0) {
+                    continue;
+                }
+                points[count] = y * tileWidth + x;
+                cr[count] = creal(view->upperLeft) + (tileX + x) * dx;
+                ci[count] = cimag(view->upperLeft) + (tileY + y) * dy;
+                count++;
+            }
+        }
+        if(count == 0) {
+            continue;
+        }
+        estimatePoints(cr, ci, count, view->maxIterations, iterations, estimates);
+
+        for(int p = 0; p < count; p++) {
+            int x = points[p] % tileWidth;
+            int y = points[p] / tileWidth;
+            view->distances[(size_t)(tileY + y) * view->width + tileX + x] = estimates[p] / pixel;
+            if(view->fillDiscs) {
+                fillDisc(view, tileX, tileY, tileWidth, tileHeight, x, y, estimates[p] / 4, dx, dy, pixel);
+            }
+        }
+    }
+
+    free(estimates);
+    free(iterations);
+    free(ci);
+    free(cr);
+    free(points);
+}
+
+/*
+ * Estimates the distance of every pixel of a view to the Mandelbrot set.
+ */
+float *
+estimateMandelbrotDistance(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int fillDiscs)
+{
+    float *distances = malloc((size_t)width * height * sizeof(float));
+    for(size_t p = 0; p < (size_t)width * height; p++) {
+        distances[p] = -1;
+    }
+
+    // Quadratische Kacheln, damit die Scheiben nicht an einer schmalen Kachel enden
+    struct DistanceView view = {
+        upperLeft, lowerRight, maxIterations, width, height,
+        (width + DISTANCE_TILE_SIZE - 1) / DISTANCE_TILE_SIZE, fillDiscs, distances
+    };
+    int tiles = view.tilesPerRow * ((height + DISTANCE_TILE_SIZE - 1) / DISTANCE_TILE_SIZE);
+    runTiles(tiles, NULL, estimateTile, &view);
+
+    return distances;
+}
+
+/*
+ * Turns a distance field into grey levels.
+ */
+unsigned char *
+colorizeDistance(
+    const float *distances,
+    int width,
+    int height)
+{
+    unsigned char *image = malloc((size_t)width * height * 3);
+
+    // Schwarz in der Menge, aufhellend bis DISTANCE_RAMP Pixel Abstand, danach weiß
+    #pragma omp parallel for
+    for(size_t p = 0; p < (size_t)width * height; p++) {
+        float shade = distances[p] < DISTANCE_RAMP ? distances[p] / DISTANCE_RAMP : 1;
+        unsigned char grey = (unsigned char)(255 * shade + 0.5f);
+        image[p * 3 + 0] = grey;
+        image[p * 3 + 1] = grey;
+        image[p * 3 + 2] = grey;
+    }
+
+    return image;
+}
+
+void
+setMandelbrotAntialiasing(int grid, float threshold)
+{
+    antialiasGrid = grid > 1 ? grid : 1;
+    antialiasThreshold = threshold > 0 ? threshold : DEFAULT_ANTIALIAS_THRESHOLD;
+}
+
+void
+setMandelbrotPalette(const unsigned char *colors, int count)
+{
+    if(colors == NULL || count < 2) {
+        free(palette);
+        palette = NULL;
+        return;
+    }
+
+    // Die Farben gleichmäßig über die Tabelle verteilen und dazwischen linear überblenden
+    uint32_t *table = malloc(PALETTE_SIZE * sizeof(uint32_t));
+    for(int e = 0; e < PALETTE_SIZE; e++) {
+        float position = (float)e * (count - 1) / (PALETTE_SIZE - 1);
+        int c = position < count - 1 ? (int)position : count - 2;
+        float f = position - c;
+        uint32_t entry = 0;
+        for(int channel = 0; channel < 3; channel++) {
+            float value = colors[c * 3 + channel] * (1 - f) + colors[(c + 1) * 3 + channel] * f;
+            entry |= (uint32_t)(value + 0.5f) << (8 * channel);
+        }
+        table[e] = entry;
+    }
+
+    free(palette);
+    palette = table;
+}
+
+void
+setMandelbrotEqualization(int enabled)
+{
+    equalization = enabled;
+}
+
+void
+setMandelbrotColorOffset(float offset)
+{
+    colorOffset = offset - floorf(offset);
+}
+
+int
+saveMandelbrotField(
+    const char *filename,
+    const float *iterations,
+    int maxIterations,
+    int width,
+    int height)
+{
+    FILE *file = fopen(filename, "wb");
+    if(file == NULL) {
+        return -1;
+    }
+
+    // Kopfzeile wie bei PPM, danach die Werte so, wie sie im Speicher liegen
+    size_t count = (size_t)width * height;
+    int ok = fprintf(file, "MBF %d %d %d\n", width, height, maxIterations) > 0
+          && fwrite(iterations, sizeof(float), count, file) == count;
+    return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+float *
+loadMandelbrotField(
+    const char *filename,
+    int *maxIterations,
+    int *width,
+    int *height)
+{
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL) {
+        return NULL;
+    }
+
+    int w, h, limit;
+    if(fscanf(file, "MBF %d %d %d", &w, &h, &limit) != 3 || fgetc(file) != '\n' || w <= 0 || h <= 0 || limit < 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    size_t count = (size_t)w * h;
+    float *iterations = malloc(count * sizeof(float));
+    if(iterations == NULL || fread(iterations, sizeof(float), count, file) != count) {
+        free(iterations);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    *maxIterations = limit;
+    *width = w;
+    *height = h;
+    return iterations;
+}
+
+int
+loadMandelbrotPalette(const char *filename)
+{
+    if(filename == NULL) {
+        setMandelbrotPalette(NULL, 0);
+        return 0;
+    }
+
+    FILE *file = fopen(filename, "r");
+    if(file == NULL) {
+        return -1;
+    }
+
+    // Eine Farbe pro Zeile, Kommentare beginnen mit #
+    int capacity = 16;
+    int count = 0;
+    unsigned char *colors = malloc(capacity * 3);
+    char line[256];
+    while(fgets(line, sizeof(line), file)) {
+        int r, g, b;
+        if(line[0] == '#' || sscanf(line, "%d %d %d", &r, &g, &b) != 3) {
+            continue;
+        }
+        if(count == capacity) {
+            capacity *= 2;
+            colors = realloc(colors, capacity * 3);
+        }
+        colors[count * 3 + 0] = r < 0 ? 0 : r > 255 ? 255 : r;
+        colors[count * 3 + 1] = g < 0 ? 0 : g > 255 ? 255 : g;
+        colors[count * 3 + 2] = b < 0 ? 0 : b > 255 ? 255 : b;
+        count++;
+    }
+    fclose(file);
+
+    int result = count >= 2 ? 0 : -1;
+    if(result == 0) {
+        setMandelbrotPalette(colors, count);
+    }
+    free(colors);
+    return result;
+}
+
+void
+setMandelbrotFormula(int type, complex double seed)
+{
+    formula.type = type;
+    formula.seedRe = creal(seed);
+    formula.seedIm = cimag(seed);
 }
 
 /*
@@ -227,43 +1380,77 @@ testEscapeSeriesForPoint(__m128 c, int maxIterations, int* it1, int* it2)
  */
 unsigned char *
 generateMandelbrot(
-    complex float upperLeft, 
-    complex float lowerRight, 
+    complex double upperLeft, 
+    complex double lowerRight, 
     int maxIterations, 
     int width, 
     int height)
 {
-	// globale Variablen für Farbschema und YUV->RGB Konvertierung initialisieren
-	rgb_p = _mm_set_ps(0.2f, -1.0f, 0.5f, 0.0f);
-	rgb_r = _mm_set_ps(1.0f*255.0f, 0.0f, 1.28033f*255.0f, 0.0f);
-	rgb_g = _mm_set_ps(1.0f*255.0f, -0.21482f*255.0f, -0.38059f*255.0f, 0.0f);
-	rgb_b = _mm_set_ps(1.0f*255.0f, 2.12782f*255.0f, 0.0f, 0.0f);
-	
-    // Allocate image buffer, row-major order, 3 channels.
-    unsigned char *image = malloc(height * width * 3);
-    __m128 cur = _mm_set_ps(cimagf(upperLeft), crealf(upperLeft), cimagf(upperLeft), crealf(upperLeft)); // Der Ausgangspunkt, in doppelter Ausführung da wir zwei komplexe Zahlen auf einmal verarbeiten
-    float dx = (crealf(lowerRight) - crealf(upperLeft))/width;   // die "Schrittgröße" für eine x-Iteration
-    float dy = (cimagf(lowerRight) - cimagf(upperLeft))/height;  // die "Schrittgröße" für eine y-Iteration
-    
-    // Die for-Schleife wird mit OpenMP parallelisiert. Sollte das nicht erlaubt sein, kann man das im Makefile ausschalten - dann wird das #pragma einfach ignoriert
-    #pragma omp parallel for schedule(dynamic)
-    for(int y = 0; y < height; y++) {
-        for(int x = 0; x < width; x+=2) {
-			// komplexe Zahlen für zwei Pixel berechnen
-			__m128 c = _mm_set_ps(dy*y, dx*(x+1), dy*y, dx*x);
-			c = _mm_add_ps(c, cur);
-			
-			// Mandelbrotfolge für beide Zahlen durchgehen
-			int index1,index2;
-			testEscapeSeriesForPoint(c, maxIterations, &index1, &index2);
-			
-			// beide Pixel einfärben
-            int offset = (y * width + x) * 3;
-            colorMapYUV(index1, maxIterations, image + offset);
-            colorMapYUV(index2, maxIterations, image+offset+3);
-        }
+    float *iterations = iterateMandelbrot(upperLeft, lowerRight, maxIterations, width, height);
+    unsigned char *image = colorizeMandelbrot(iterations, maxIterations, width, height);
+    // Die Unterabtastung iteriert nur die Mandelbrotfolge
+    if(formula.type == FORMULA_MANDELBROT) {
+        antialiasMandelbrot(iterations, image, upperLeft, lowerRight, maxIterations, width, height, antialiasGrid, antialiasThreshold);
     }
 
+    free(iterations);
     return image;
 }
 
+/*
+ * Generates an image of a Mandelbrot set by recursive rectangle subdivision.
+ */
+unsigned char *
+generateMandelbrotSubdivision(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height)
+{
+    float *iterations = iterateMandelbrotSubdivision(upperLeft, lowerRight, maxIterations, width, height);
+    unsigned char *image = colorizeMandelbrot(iterations, maxIterations, width, height);
+
+    free(iterations);
+    return image;
+}
+
+/*
+ * Generates an image of a Mandelbrot set in double-double precision.
+ */
+unsigned char *
+generateMandelbrotDoubleDouble(
+    deepfloat centerRe,
+    deepfloat centerIm,
+    double spanRe,
+    double spanIm,
+    int maxIterations,
+    int width,
+    int height)
+{
+    float *iterations = iterateMandelbrotDoubleDouble(centerRe, centerIm, spanRe, spanIm, maxIterations, width, height);
+    unsigned char *image = colorizeMandelbrot(iterations, maxIterations, width, height);
+
+    free(iterations);
+    return image;
+}
+
+/*
+ * Generates an image of a Mandelbrot set with perturbation theory.
+ */
+unsigned char *
+generateMandelbrotPerturbation(
+    deepfloat centerRe,
+    deepfloat centerIm,
+    double spanRe,
+    double spanIm,
+    int maxIterations,
+    int width,
+    int height)
+{
+    float *iterations = iterateMandelbrotPerturbation(centerRe, centerIm, spanRe, spanIm, maxIterations, width, height);
+    unsigned char *image = colorizeMandelbrot(iterations, maxIterations, width, height);
+
+    free(iterations);
+    return image;
+}
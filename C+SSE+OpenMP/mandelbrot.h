@@ -15,15 +15,19 @@
 #define MANDELBROT_HEADER
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <complex.h>
 #include <math.h>
 
 #include "globals.h"
+#include "deepfloat.h"
 
 /*
  * Generates an image of a Mandelbrot set in the given bounded complex plane
  * for a given sampling specified in width times height pixels. Uses colormapping
  * to determine the pixel's color from its iteration return value.
+ * Iterates in float as long as float can resolve the pixels and switches to
+ * double for deeper zooms.
  * 
  * Arguments:
  *	upperLeft - Upper left corner of the complex plane for calculation
@@ -38,10 +42,499 @@
  */
 unsigned char *
 generateMandelbrot(
-    complex float upperLeft,
-    complex float lowerRight, 
+    complex double upperLeft,
+    complex double lowerRight, 
     int maxIterations, 
     int width, 
     int height);
 
+/*
+ * Iterates the Mandelbrot series for every pixel of a view, without colouring
+ * it. This is the expensive part of generateMandelbrot; the result can be kept
+ * and coloured (again) with colorizeMandelbrot.
+ *
+ * Arguments:
+ *	upperLeft, lowerRight, maxIterations, width, height - see generateMandelbrot
+ *
+ * Returns:
+ *   An array of width * height floats in row-major order holding the smoothed
+ *   iteration number of every pixel, exactly maxIterations for pixels inside
+ *   the Mandelbrot set.
+ */
+float *
+iterateMandelbrot(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * An iteration field together with where the series of its pixels stopped.
+ * Initialise it with zeros before the first use and release it with
+ * freeMandelbrotState.
+ */
+struct MandelbrotState {
+    complex double upperLeft;
+    complex double lowerRight;
+    int maxIterations;
+    int width;
+    int height;
+    float *iterations;   // the field, as returned by iterateMandelbrot
+    double *zr;          // last series member of every pixel
+    double *zi;
+    int *iteration;      // iterations executed for every pixel, -1 once it escaped, -2 if it is in the set
+};
+
+/*
+ * Iterates the Mandelbrot series for every pixel of a view like
+ * iterateMandelbrot, but keeps the state of every pixel. If state already
+ * holds the same view with a lower (or equal) maxIterations, only the pixels
+ * that reached the old limit without being decided are iterated further, from
+ * where they stopped. Escaped pixels and pixels known to be in the set are
+ * reused as they are. The result is the same as iterating from scratch.
+ *
+ * Arguments:
+ *	state - The state of the previous call, replaced if the view differs
+ *	upperLeft, lowerRight, maxIterations, width, height - see generateMandelbrot
+ *
+ * Returns:
+ *   state->iterations, which stays owned by the state
+ */
+float *
+iterateMandelbrotResumable(
+    struct MandelbrotState *state,
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Releases the buffers of a state, it can be used again afterwards.
+ */
+void
+freeMandelbrotState(struct MandelbrotState *state);
+
+/*
+ * Sets the size of the tiles iterateMandelbrot (and generateMandelbrot)
+ * distributes among the threads. Values below 1 select the default size.
+ */
+void
+setMandelbrotTileSize(int width, int height);
+
+/*
+ * Iterates the tile of tileWidth times tileHeight pixels starting at pixel
+ * (tileX, tileY) of the view into a buffer the caller owns. Pixel (x, y) of
+ * the tile gets the same value as pixel (tileX + x, tileY + y) of
+ * iterateMandelbrot. A tile is iterated by the calling thread, several tiles
+ * can be iterated in parallel.
+ *
+ * Arguments:
+ *	upperLeft, lowerRight, maxIterations, width, height - The whole view, see generateMandelbrot
+ *	tileX, tileY - First pixel of the tile
+ *	tileWidth, tileHeight - Size of the tile in pixels
+ *	iterations - Receives the smoothed iteration numbers of the tile
+ *	stride - Distance between two rows of the tile in iterations in floats (at least tileWidth)
+ */
+void
+iterateMandelbrotTile(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int tileX,
+    int tileY,
+    int tileWidth,
+    int tileHeight,
+    float *iterations,
+    size_t stride);
+
+/*
+ * Like iterateMandelbrotTile, but colours the tile like generateMandelbrot.
+ *
+ * Arguments:
+ *	image - Receives the RGB 8-bit values of the tile
+ *	stride - Distance between two rows of the tile in image in bytes (at least tileWidth * 3)
+ */
+void
+renderMandelbrotTile(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int tileX,
+    int tileY,
+    int tileWidth,
+    int tileHeight,
+    unsigned char *image,
+    size_t stride);
+
+/*
+ * Renders the rows firstRow to firstRow + rows - 1 of a view like
+ * renderMandelbrotTile, in parallel. Pictures too large for memory can be
+ * rendered band after band and each band written out before the next one,
+ * so memory use only depends on the width of the picture and the height of
+ * a band. Every band only sees its own pixels, so anti-aliasing and histogram
+ * equalisation are not applied.
+ *
+ * Arguments:
+ *	upperLeft, lowerRight, maxIterations, width, height - The whole view, see generateMandelbrot
+ *	firstRow - First row of the band
+ *	rows - Number of rows in the band
+ *	image - Receives the RGB 8-bit values of the band, starting with row firstRow
+ *	stride - Distance from one row of the band to the next in image in bytes, at least
+ *	         width * 3; negative to store the rows bottom-up, as in a PPM file from mapPPM
+ */
+void
+renderMandelbrotBand(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int firstRow,
+    int rows,
+    unsigned char *image,
+    ptrdiff_t stride);
+
+/*
+ * Like iterateMandelbrot, but with the rectangle subdivision of
+ * generateMandelbrotSubdivision.
+ */
+float *
+iterateMandelbrotSubdivision(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Like iterateMandelbrot, in double-double precision. The arguments are those
+ * of generateMandelbrotDoubleDouble.
+ */
+float *
+iterateMandelbrotDoubleDouble(
+    deepfloat centerRe,
+    deepfloat centerIm,
+    double spanRe,
+    double spanIm,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Like iterateMandelbrot, with perturbation theory. The arguments are those of
+ * generateMandelbrotPerturbation.
+ */
+float *
+iterateMandelbrotPerturbation(
+    deepfloat centerRe,
+    deepfloat centerIm,
+    double spanRe,
+    double spanIm,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Colours an iteration field as returned by the iterateMandelbrot functions.
+ *
+ * Arguments:
+ *	iterations - Smoothed iteration number of every pixel in row-major order
+ *	maxIterations - The limit the field was iterated with, pixels with this value are black
+ *	width - Width of the field in pixels
+ *	height - Height of the field in pixels
+ *
+ * Returns:
+ *   An array of RGB 8-bit values (unsigned char), see generateMandelbrot.
+ */
+unsigned char *
+colorizeMandelbrot(
+    const float *iterations,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Estimates the distance of every pixel of a view to the Mandelbrot set from
+ * the derivative dz/dc (2|z|ln|z| / |dz/dc| at escape). Pixels closer than a
+ * pixel show the thin filaments that escape-time colouring misses.
+ *
+ * With fillDiscs, a quarter of the estimate of an iterated pixel is a disc
+ * that is certainly outside the set (Koebe 1/4 theorem). Every pixel inside
+ * that disc gets its distance to the rim of the disc as a lower bound instead
+ * of being iterated. Only pixels that this makes at least DISTANCE_RAMP pixels
+ * away are filled, so colorizeDistance gives them the same white as iterated
+ * pixels that far away. Pixels are iterated from a coarse to a fine grid, so
+ * that few iterated pixels cover most of the exterior.
+ *
+ * Arguments:
+ *	upperLeft, lowerRight, maxIterations, width, height - see generateMandelbrot
+ *	fillDiscs - If not 0, pixels inside the discs are filled instead of iterated
+ *
+ * Returns:
+ *   An array of width * height floats in row-major order holding the
+ *   distance of every pixel in pixels (the larger side of a pixel), 0 for
+ *   pixels in the set.
+ */
+float *
+estimateMandelbrotDistance(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int fillDiscs);
+
+/*
+ * Colours a distance field as returned by estimateMandelbrotDistance: black in
+ * the set, brightening up to white at DISTANCE_RAMP pixels away.
+ *
+ * Returns:
+ *   An array of RGB 8-bit values (unsigned char), see generateMandelbrot.
+ */
+unsigned char *
+colorizeDistance(
+    const float *distances,
+    int width,
+    int height);
+
+/*
+ * Anti-aliases a coloured view where it needs it. Pixels whose smoothed
+ * iteration number differs from one of their four neighbours by more than
+ * threshold * maxIterations get grid * grid - 1 extra samples, one jittered
+ * sample in every cell of a grid x grid raster over the pixel. The colours
+ * of all samples are averaged. Everywhere else, one sample per pixel is kept.
+ *
+ * Arguments:
+ *	iterations - The field the image was coloured from, see colorizeMandelbrot
+ *	image - The image, changed in place
+ *	upperLeft, lowerRight, maxIterations, width, height - The view of the field, see generateMandelbrot
+ *	grid - Samples per pixel along each axis, values below 2 leave the image as it is
+ *	threshold - Difference of neighbouring iteration numbers, relative to maxIterations, that marks an edge
+ */
+void
+antialiasMandelbrot(
+    const float *iterations,
+    unsigned char *image,
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int grid,
+    float threshold);
+
+/*
+ * Enables anti-aliasing in generateMandelbrot, see antialiasMandelbrot. A
+ * grid below 2 disables it (the default), a threshold of 0 or below selects
+ * the default threshold.
+ */
+void
+setMandelbrotAntialiasing(int grid, float threshold);
+
+/*
+ * Colours with a palette instead of the YUV scheme in colorizeMandelbrot,
+ * generateMandelbrot, renderMandelbrotTile and antialiasMandelbrot. The colours
+ * are spread evenly from iteration 0 to maxIterations and blended linearly in
+ * between; pixels in the set stay black.
+ *
+ * Arguments:
+ *	colors - count RGB 8-bit triples, NULL to go back to the YUV scheme
+ *	count - Number of colours, at least 2
+ */
+void
+setMandelbrotPalette(const unsigned char *colors, int count);
+
+/*
+ * Loads a palette for setMandelbrotPalette from a text file with one colour
+ * per line as three numbers from 0 to 255 (red green blue). Lines starting
+ * with # and lines without three numbers are skipped.
+ *
+ * Arguments:
+ *	filename - The palette file, NULL to go back to the YUV scheme
+ *
+ * Returns:
+ *   0 on success, -1 if the file cannot be read or holds fewer than two
+ *   colours (the current palette stays in use then).
+ */
+int
+loadMandelbrotPalette(const char *filename);
+
+/*
+ * Switches colorizeMandelbrot (and antialiasMandelbrot) to histogram
+ * equalisation: instead of index / maxIterations, a pixel is coloured by the
+ * share of the pixels outside the set that need fewer iterations, so every
+ * colour covers about as many pixels even at high iteration counts. The
+ * histograms are built per thread and reduced in parallel. renderMandelbrotTile
+ * only sees one tile and keeps the plain ramp.
+ *
+ * Arguments:
+ *	enabled - 1 for histogram equalisation, 0 for the plain ramp (default)
+ */
+void
+setMandelbrotEqualization(int enabled);
+
+/*
+ * Shifts the colours of colorizeMandelbrot along the iteration numbers, for
+ * colour cycling: every pixel is coloured as if it had offset * maxIterations
+ * more iterations, wrapping around at maxIterations. Pixels in the set stay
+ * black.
+ *
+ * Arguments:
+ *	offset - Shift as a fraction of maxIterations, only the fractional part counts (default 0)
+ */
+void
+setMandelbrotColorOffset(float offset);
+
+/*
+ * Saves an iteration field so that it can be coloured again later without
+ * iterating it. The file holds a text line "MBF width height maxIterations"
+ * followed by the floats in native byte order.
+ *
+ * Arguments:
+ *	filename - The file to write
+ *	iterations - The field, as returned by the iterateMandelbrot functions
+ *	maxIterations - The limit the field was iterated with (0 for a distance field)
+ *	width, height - Size of the field in pixels
+ *
+ * Returns:
+ *   0 on success, -1 if the file cannot be written.
+ */
+int
+saveMandelbrotField(
+    const char *filename,
+    const float *iterations,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Loads an iteration field saved by saveMandelbrotField.
+ *
+ * Arguments:
+ *	filename - The file to read
+ *	maxIterations, width, height - Receive the values the field was saved with
+ *
+ * Returns:
+ *   The field, to be freed by the caller, or NULL if the file cannot be read.
+ */
+float *
+loadMandelbrotField(
+    const char *filename,
+    int *maxIterations,
+    int *width,
+    int *height);
+
+/*
+ * Selects the series iterateMandelbrot, iterateMandelbrotTile and
+ * generateMandelbrot compute (one of the FORMULA_ constants of globals.h).
+ * Each formula has its own compiled copy of the kernel loop, so the default
+ * FORMULA_MANDELBROT runs as fast as before. The other formulas are colored
+ * the same way, but resuming, anti-aliasing, distance estimation,
+ * subdivision, double-double and perturbation stay Mandelbrot-only;
+ * generateMandelbrot skips anti-aliasing for them.
+ *
+ * Arguments:
+ *	formula - The formula, FORMULA_MANDELBROT by default
+ *	seed - The constant c of FORMULA_JULIA, ignored by the others
+ */
+void
+setMandelbrotFormula(int formula, complex double seed);
+
+/*
+ * Generates the same image as generateMandelbrot, but skips the pixels inside
+ * rectangles whose border has one and the same iteration number (Mariani-Silver
+ * subdivision). Large parts of the set's interior are filled without iterating.
+ * The arguments and the result are those of generateMandelbrot.
+ */
+unsigned char *
+generateMandelbrotSubdivision(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Checks whether the pixels of a view are too close to each other even for the
+ * double kernel of generateMandelbrot, i.e. whether the view has to be rendered
+ * with generateMandelbrotPerturbation.
+ */
+int
+needsPerturbation(
+    complex double upperLeft,
+    complex double lowerRight,
+    int width,
+    int height);
+
+/*
+ * Generates an image of a Mandelbrot set for zooms beyond double precision
+ * (down to a span of roughly 1e-27, i.e. 1e-30 per pixel). Every coordinate is
+ * iterated as the unevaluated sum of two doubles (double-double, about 106 bits),
+ * several pixels at once in SIMD registers.
+ *
+ * Arguments:
+ *	centerRe - Real part of the centre of the view
+ *	centerIm - Imaginary part of the centre of the view
+ *	spanRe - Width of the view in the complex plane
+ *	spanIm - Height of the view in the complex plane
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *	width - Width of the resulting image in pixels
+ *	height - Height of the resulting image in pixels
+ *
+ * Returns:
+ *   An array of RGB 8-bit values (unsigned char), see generateMandelbrot.
+ */
+unsigned char *
+generateMandelbrotDoubleDouble(
+    deepfloat centerRe,
+    deepfloat centerIm,
+    double spanRe,
+    double spanIm,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Generates an image of a Mandelbrot set for zooms far beyond double precision
+ * (down to about 1e-300 per pixel). Only one reference orbit is iterated in high
+ * precision, every pixel is iterated in double as a small offset to it
+ * (perturbation theory). Pixels where this loses precision are detected and
+ * iterated again against new references; how many are still left after the
+ * last one is printed.
+ *
+ * Arguments:
+ *	centerRe - Real part of the centre of the view
+ *	centerIm - Imaginary part of the centre of the view
+ *	spanRe - Width of the view in the complex plane
+ *	spanIm - Height of the view in the complex plane
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *	width - Width of the resulting image in pixels
+ *	height - Height of the resulting image in pixels
+ *
+ * Returns:
+ *   An array of RGB 8-bit values (unsigned char), see generateMandelbrot.
+ */
+unsigned char *
+generateMandelbrotPerturbation(
+    deepfloat centerRe,
+    deepfloat centerIm,
+    double spanRe,
+    double spanIm,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Returns the name of the instruction set whose kernel generateMandelbrot uses.
+ * The widest one supported by the CPU is chosen at the first call.
+ */
+const char *
+mandelbrotKernelName(void);
+
 #endif /* MANDELBROT_HEADER */
@@ -0,0 +1,400 @@
+/*
+ *   Copyright (C) 2013 Daniel Thürck
+ *   Copyright (C) 2013 Stefan Schmidt
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+
+/*
+ * Tiefe Zooms mit Störungsrechnung: Nur die Referenzfolge Z_n wird in hoher
+ * Genauigkeit berechnet, als deepfloat mit so vielen Bits, wie die Pixelgröße
+ * verlangt. Für jeden Pixel c = C + dc wird nur die kleine Abweichung
+ * dz_n = z_n - Z_n in double iteriert:
+ *
+ *   dz_{n+1} = 2 Z_n dz_n + dz_n^2 + dc
+ *
+ * Das übernehmen die Kernel (perturbPoints), alle Lanes laufen dabei im Gleichschritt
+ * über die Referenz. Wird |Z_n + dz_n| im Vergleich zu |Z_n| sehr klein, reicht die
+ * Genauigkeit der Abweichung nicht mehr aus (Glitch, Kriterium nach Pauldelbrot).
+ * Solche Pixel werden mit einer neuen Referenz aus dem Inneren des größten
+ * betroffenen Bereichs noch einmal gerechnet. Da die Abweichungen doubles sind,
+ * endet das Verfahren bei Pixeln um 1e-300.
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#include "perturbation.h"
+#include "kernel.h"
+
+// Höchstzahl neuer Referenzen, danach werden verbleibende Glitches ohne Prüfung übernommen
+#define MAX_REFERENCES 64
+
+// Punkte pro Richtung, an denen eine bessere erste Referenz gesucht wird, wenn die Mitte entkommt
+#define REFERENCE_PROBES 6
+
+// Anzahl der Pixel, die bei der Nachberechnung von Glitches am Stück an die Kernel gehen
+#define PERTURBATION_CHUNK 256
+
+// Vorübergehende Markierungen für Glitches bei der Suche nach einer neuen Referenz:
+// im untersuchten Bereich, und vom Rand des Bereichs aus schon erreicht
+#define VISITED -2
+#define REACHED -3
+
+/*
+ * Eine Referenzfolge und ihre Lage im Ausschnitt
+ */
+struct Reference {
+	double offsetRe;  // Abstand der Referenz zur Mitte des Ausschnitts
+	double offsetIm;
+	struct ReferenceOrbit orbit;
+};
+
+/*
+ * Iteriert die Referenzfolge für den Punkt center + offset in hoher Genauigkeit
+ *
+ * Arguments:
+ *  centerRe, centerIm - Mitte des Ausschnitts
+ *  offsetRe, offsetIm - Abstand des Punkts zur Mitte
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *  limbs - Anzahl der Wörter, mit denen gerechnet wird (deepLimbs)
+ *  zr, zi - Erhalten die Folgeglieder als double, NULL wenn nur die Länge gebraucht wird
+ *
+ * Returns:
+ *  Anzahl der Folgeglieder bis einschließlich dem ersten außerhalb von RADIUS, höchstens maxIterations
+ */
+static int
+iterateReference(const deepfloat *centerRe, const deepfloat *centerIm, double offsetRe, double offsetIm,
+                 int maxIterations, int limbs, double *zr, double *zi)
+{
+	deepfloat cr = deepFromDouble(offsetRe);
+	deepfloat ci = deepFromDouble(offsetIm);
+	deepAdd(&cr, centerRe, &cr, limbs);
+	deepAdd(&ci, centerIm, &ci, limbs);
+
+	deepfloat x = deepFromDouble(0);
+	deepfloat y = deepFromDouble(0);
+	deepfloat xx, yy, xy;
+	int n;
+
+	for (n = 0; n < maxIterations; n++)
+	{
+		double re = deepToDouble(&x);
+		double im = deepToDouble(&y);
+		if (zr != NULL) {
+			zr[n] = re;
+			zi[n] = im;
+		}
+
+		// Ab hier ist die Referenz für weitere Iterationen nicht mehr zu gebrauchen
+		if (re*re + im*im > RADIUS*RADIUS) {
+			n++;
+			break;
+		}
+
+		deepMul(&xx, &x, &x, limbs);
+		deepMul(&yy, &y, &y, limbs);
+		deepMul(&xy, &x, &y, limbs);
+		deepSub(&x, &xx, &yy, limbs);
+		deepAdd(&x, &x, &cr, limbs);
+		deepAdd(&y, &xy, &xy, limbs);
+		deepAdd(&y, &y, &ci, limbs);
+	}
+
+	return n;
+}
+
+/*
+ * Berechnet die Referenzfolge für den Punkt center + offset
+ *
+ * Arguments:
+ *  ref - Referenz, orbit.zr und orbit.zi müssen Platz für maxIterations Werte haben
+ *  sonst wie iterateReference
+ */
+static void
+computeReference(struct Reference *ref, const deepfloat *centerRe, const deepfloat *centerIm,
+                 double offsetRe, double offsetIm, int maxIterations, int limbs)
+{
+	ref->offsetRe = offsetRe;
+	ref->offsetIm = offsetIm;
+	ref->orbit.length = iterateReference(centerRe, centerIm, offsetRe, offsetIm, maxIterations, limbs,
+	                                     ref->orbit.zr, ref->orbit.zi);
+}
+
+/*
+ * Iteriert eine Liste von Pixeln als Abweichung von der Referenz
+ *
+ * Arguments:
+ *  kernels - die Kernel für den Befehlssatz der CPU
+ *  ref - die Referenz
+ *  pixels - Indizes der Pixel (row-major)
+ *  count - Anzahl der Pixel
+ *  dx, dy, spanRe, spanIm, width - Lage der Pixel im Ausschnitt
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *  detectGlitches - 0 um Glitches zu ignorieren (für Pixel, die keine Referenz mehr bekommen)
+ *  iterations - das Ergebnis für alle Pixel des Ausschnitts
+ */
+static void
+perturbPixels(const struct KernelSet *kernels, const struct Reference *ref, const size_t *pixels, size_t count,
+              double dx, double dy, double spanRe, double spanIm, int width,
+              int maxIterations, int detectGlitches, float *iterations)
+{
+    #pragma omp parallel
+    {
+        double dcr[PERTURBATION_CHUNK];
+        double dci[PERTURBATION_CHUNK];
+        float result[PERTURBATION_CHUNK];
+
+        #pragma omp for schedule(dynamic)
+        for(size_t start = 0; start < count; start += PERTURBATION_CHUNK) {
+            int n = count - start < PERTURBATION_CHUNK ? (int)(count - start) : PERTURBATION_CHUNK;
+            for(int k = 0; k < n; k++) {
+                dcr[k] = dx*(pixels[start+k] % width) - spanRe/2 - ref->offsetRe;
+                dci[k] = spanIm/2 - dy*(pixels[start+k] / width) - ref->offsetIm;
+            }
+
+            kernels->perturbPoints(&ref->orbit, dcr, dci, n, maxIterations, detectGlitches, result);
+
+            for(int k = 0; k < n; k++) {
+                iterations[pixels[start+k]] = result[k];
+            }
+        }
+    }
+}
+
+/*
+ * Bestimmt die 4er-Nachbarn eines Pixels
+ *
+ * Arguments:
+ *  p - Der Pixel (row-major)
+ *  neighbours - Erhält die Nachbarn, SIZE_MAX für Nachbarn außerhalb des Bildes
+ */
+static inline void
+findNeighbours(size_t p, int width, int height, size_t neighbours[4])
+{
+	int x = p % width;
+	int y = p / width;
+
+	neighbours[0] = x > 0 ? p-1 : SIZE_MAX;
+	neighbours[1] = x < width-1 ? p+1 : SIZE_MAX;
+	neighbours[2] = y > 0 ? p-width : SIZE_MAX;
+	neighbours[3] = y < height-1 ? p+width : SIZE_MAX;
+}
+
+/*
+ * Sammelt ausgehend von einem Glitch den zusammenhängenden Bereich von Glitches
+ * (Breitensuche über die 4er-Nachbarschaft), seine Pixel werden als VISITED markiert
+ *
+ * Arguments:
+ *  start - Ein Glitch des Bereichs
+ *  area - Erhält die Pixel des Bereichs
+ *
+ * Returns:
+ *  Anzahl der Pixel des Bereichs
+ */
+static size_t
+collectArea(float *iterations, int width, int height, size_t start, size_t *area)
+{
+	size_t head = 0;
+	size_t tail = 0;
+
+	area[tail++] = start;
+	iterations[start] = VISITED;
+	while (head < tail)
+	{
+		size_t neighbours[4];
+		findNeighbours(area[head++], width, height, neighbours);
+		for (int k = 0; k < 4; k++)
+		{
+			if (neighbours[k] != SIZE_MAX && iterations[neighbours[k]] == GLITCHED) {
+				iterations[neighbours[k]] = VISITED;
+				area[tail++] = neighbours[k];
+			}
+		}
+	}
+
+	return tail;
+}
+
+/*
+ * Sucht den größten zusammenhängenden Bereich von Glitches und gibt dessen Pixel
+ * zurück, der am weitesten von seinem Rand entfernt ist. Eine Referenz dort passt zu
+ * möglichst vielen Pixeln des Bereichs, auch wenn er nicht konvex ist (der Pixel am
+ * Schwerpunkt kann dann am Rand liegen).
+ *
+ * Arguments:
+ *  iterations - Ergebnis des Ausschnitts, die Glitches sind danach wieder GLITCHED
+ *  glitches, count - Alle Glitches
+ *  queue - Platz für 2 * count Pixel
+ */
+static size_t
+chooseReferencePixel(float *iterations, int width, int height, const size_t *glitches, size_t count, size_t *queue)
+{
+	size_t largest = glitches[0];
+	size_t largestSize = 0;
+	for (size_t g = 0; g < count; g++)
+	{
+		if (iterations[glitches[g]] == GLITCHED) {
+			size_t size = collectArea(iterations, width, height, glitches[g], queue);
+			if (size > largestSize) {
+				largestSize = size;
+				largest = glitches[g];
+			}
+		}
+	}
+	for (size_t g = 0; g < count; g++)
+		iterations[glitches[g]] = GLITCHED;
+
+	// Vom Rand des Bereichs (auch dem Bildrand) aus schichtweise nach innen, der zuletzt erreichte Pixel liegt am tiefsten
+	size_t size = collectArea(iterations, width, height, largest, queue);
+	size_t *layers = queue + size;
+	size_t head = 0;
+	size_t tail = 0;
+	for (size_t k = 0; k < size; k++)
+	{
+		size_t neighbours[4];
+		findNeighbours(queue[k], width, height, neighbours);
+		for (int j = 0; j < 4; j++)
+		{
+			if (neighbours[j] == SIZE_MAX || (iterations[neighbours[j]] != VISITED && iterations[neighbours[j]] != REACHED)) {
+				iterations[queue[k]] = REACHED;
+				layers[tail++] = queue[k];
+				break;
+			}
+		}
+	}
+	while (head < tail)
+	{
+		size_t neighbours[4];
+		findNeighbours(layers[head++], width, height, neighbours);
+		for (int k = 0; k < 4; k++)
+		{
+			if (neighbours[k] != SIZE_MAX && iterations[neighbours[k]] == VISITED) {
+				iterations[neighbours[k]] = REACHED;
+				layers[tail++] = neighbours[k];
+			}
+		}
+	}
+
+	for (size_t k = 0; k < size; k++)
+		iterations[queue[k]] = GLITCHED;
+
+	return layers[tail - 1];
+}
+
+size_t
+iteratePerturbation(
+    const deepfloat *centerRe,
+    const deepfloat *centerIm,
+    double spanRe,
+    double spanIm,
+    int maxIterations,
+    int width,
+    int height,
+    float *iterations)
+{
+    double dx = spanRe / width;   // die "Schrittgröße" für eine x-Iteration
+    double dy = spanIm / height;  // die "Schrittgröße" für eine y-Iteration
+
+    const struct KernelSet *kernels = selectKernels();
+
+    // Die Referenzen werden nur so genau gerechnet, wie es die Pixel verlangen
+    int limbs = deepLimbs(fmin(dx, dy));
+
+    // Als erste Referenz dient die Mitte. Entkommt sie vor maxIterations, wird der Ausschnitt in einem
+    // Gitter abgesucht und der Punkt mit der längsten Folge genommen; dafür reichen die Längen.
+    double bestRe = 0;
+    double bestIm = 0;
+    int bestLength = iterateReference(centerRe, centerIm, 0, 0, maxIterations, limbs, NULL, NULL);
+    if (bestLength < maxIterations) {
+        int lengths[REFERENCE_PROBES * REFERENCE_PROBES];
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < REFERENCE_PROBES * REFERENCE_PROBES; k++) {
+            double probeRe = ((k % REFERENCE_PROBES + 0.5) / REFERENCE_PROBES - 0.5) * spanRe;
+            double probeIm = ((k / REFERENCE_PROBES + 0.5) / REFERENCE_PROBES - 0.5) * spanIm;
+            lengths[k] = iterateReference(centerRe, centerIm, probeRe, probeIm, maxIterations, limbs, NULL, NULL);
+        }
+
+        for (int k = 0; k < REFERENCE_PROBES * REFERENCE_PROBES; k++) {
+            if (lengths[k] > bestLength) {
+                bestLength = lengths[k];
+                bestRe = ((k % REFERENCE_PROBES + 0.5) / REFERENCE_PROBES - 0.5) * spanRe;
+                bestIm = ((k / REFERENCE_PROBES + 0.5) / REFERENCE_PROBES - 0.5) * spanIm;
+            }
+        }
+    }
+
+    struct Reference ref;
+    ref.orbit.zr = malloc(maxIterations * sizeof(double));
+    ref.orbit.zi = malloc(maxIterations * sizeof(double));
+    computeReference(&ref, centerRe, centerIm, bestRe, bestIm, maxIterations, limbs);
+
+    // Erster Durchgang über alle Pixel, zeilenweise
+    #pragma omp parallel
+    {
+        double *dcr = malloc(width * sizeof(double));
+        double *dci = malloc(width * sizeof(double));
+
+        #pragma omp for schedule(dynamic)
+        for(int y = 0; y < height; y++) {
+            for(int x = 0; x < width; x++) {
+                dcr[x] = dx*x - spanRe/2 - ref.offsetRe;
+                dci[x] = spanIm/2 - dy*y - ref.offsetIm;
+            }
+            kernels->perturbPoints(&ref.orbit, dcr, dci, width, maxIterations, 1, iterations + (size_t)y * width);
+        }
+
+        free(dcr);
+        free(dci);
+    }
+
+    // Glitches einsammeln
+    size_t glitchCount = 0;
+    for(size_t p = 0; p < (size_t)width * height; p++) {
+        glitchCount += iterations[p] == GLITCHED;
+    }
+    size_t *glitches = malloc(glitchCount * sizeof(size_t));
+    size_t *queue = malloc(2 * glitchCount * sizeof(size_t));
+    glitchCount = 0;
+    for(size_t p = 0; p < (size_t)width * height; p++) {
+        if (iterations[p] == GLITCHED) {
+            glitches[glitchCount++] = p;
+        }
+    }
+
+    // Solange es Glitches gibt, mit einer neuen Referenz im größten Glitch-Bereich nachrechnen.
+    // Der Referenzpixel selbst hat nie einen Glitch, jeder Durchgang macht also Fortschritt.
+    for(int pass = 0; pass < MAX_REFERENCES && glitchCount > 0; pass++) {
+        size_t p = chooseReferencePixel(iterations, width, height, glitches, glitchCount, queue);
+        computeReference(&ref, centerRe, centerIm, dx*(p % width) - spanRe/2, spanIm/2 - dy*(p / width), maxIterations, limbs);
+
+        perturbPixels(kernels, &ref, glitches, glitchCount, dx, dy, spanRe, spanIm, width, maxIterations, 1, iterations);
+
+        size_t remaining = 0;
+        for(size_t k = 0; k < glitchCount; k++) {
+            if (iterations[glitches[k]] == GLITCHED) {
+                glitches[remaining++] = glitches[k];
+            }
+        }
+        glitchCount = remaining;
+    }
+
+    // Was dann noch übrig ist, wird mit der letzten Referenz ohne Glitch-Erkennung gerechnet
+    perturbPixels(kernels, &ref, glitches, glitchCount, dx, dy, spanRe, spanIm, width, maxIterations, 0, iterations);
+
+    free(queue);
+    free(glitches);
+    free(ref.orbit.zr);
+    free(ref.orbit.zi);
+
+    return glitchCount;
+}
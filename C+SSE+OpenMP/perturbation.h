@@ -0,0 +1,51 @@
+/*   Copyright (C) 2013 Daniel Thürck
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+#ifndef PERTURBATION_HEADER
+#define PERTURBATION_HEADER
+
+#include "mandelbrot.h"
+
+/*
+ * Iterates every pixel of a view as an offset to a high-precision reference
+ * orbit (perturbation theory). Pixels whose offset loses precision against the
+ * reference ("glitches") are detected and iterated again against a new
+ * reference taken from inside the largest glitched area. The references are
+ * iterated with as many bits as the size of the pixels asks for.
+ *
+ * Arguments:
+ *	centerRe - Real part of the centre of the view
+ *	centerIm - Imaginary part of the centre of the view
+ *	spanRe - Width of the view in the complex plane
+ *	spanIm - Height of the view in the complex plane
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *	width - Width of the view in pixels
+ *	height - Height of the view in pixels
+ *	iterations - Array of width * height ints that receives the (smoothed) iteration numbers in row-major order
+ *
+ * Returns:
+ *   The number of pixels still glitched after the last reference. They are
+ *   iterated against it without glitch detection and may be inaccurate.
+ */
+size_t
+iteratePerturbation(
+    const deepfloat *centerRe,
+    const deepfloat *centerIm,
+    double spanRe,
+    double spanIm,
+    int maxIterations,
+    int width,
+    int height,
+    float *iterations);
+
+#endif /* PERTURBATION_HEADER */
@@ -11,13 +11,138 @@
  *   You should have received a copy of the GNU General Public License along with this program;
  *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
  */
+#define _POSIX_C_SOURCE 200112L	// mmap, posix_fallocate
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 
 #include "ppm.h"
 
-void exportPPM(const char *filename, struct PPM *image)
+#if PPM_MAPPED
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+FILE *
+beginPPM(const char *filename, size_t width, size_t height)
+{
+    FILE *img = fopen(filename, "wb");
+    if (img != NULL && fprintf(img, "P6\n%zu %zu\n255\n", width, height) < 0) {
+        fclose(img);
+        return NULL;
+    }
+    return img;
+}
+
+int
+writePPMBand(FILE *img, const unsigned char *data, size_t width, size_t rows)
+{
+    // Zeilen am Stück schreiben, von unten nach oben wie die ganze Datei
+    size_t row = width * 3;
+    for (size_t y = rows; y > 0; y--) {
+        if (fwrite(data + (y - 1) * row, 1, row, img) != row) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int
+endPPM(FILE *img)
+{
+    return fclose(img) == 0 ? 0 : -1;
+}
+
+#if PPM_MAPPED
+int
+mapPPM(const char *filename, size_t width, size_t height, struct PPMMap *map)
+{
+    char header[64];
+    int headerLength = snprintf(header, sizeof(header), "P6\n%zu %zu\n255\n", width, height);
+    size_t length = headerLength + width * height * 3;
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        printf("Cannot create %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    // Den Platz vorher belegen, sonst endet eine volle Platte erst beim Zurückschreiben mit SIGBUS.
+    // Ohne posix_fallocate (z.B. macOS) bekommt die Datei nur ihre Größe.
+    void *base = MAP_FAILED;
+#if defined(_POSIX_ADVISORY_INFO) && _POSIX_ADVISORY_INFO > 0
+    int error = posix_fallocate(fd, 0, (off_t)length);
+#else
+    int error = ftruncate(fd, (off_t)length) == 0 ? 0 : errno;
+#endif
+    if (error != 0) {
+        printf("Cannot allocate %zu bytes for %s: %s\n", length, filename, strerror(error));
+    } else {
+        base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            printf("Cannot map %s into memory: %s\n", filename, strerror(errno));
+        }
+    }
+    close(fd);
+
+    // Keine leere oder halb angelegte Datei zurücklassen
+    if (base == MAP_FAILED) {
+        unlink(filename);
+        return -1;
+    }
+
+    memcpy(base, header, headerLength);
+    map->base = base;
+    map->length = length;
+    map->data = (unsigned char *)base + headerLength;
+    return 0;
+}
+
+int
+unmapPPM(struct PPMMap *map)
+{
+    // Erst zurückschreiben, nur msync meldet Fehler beim Schreiben (z.B. EIO) noch an den Aufrufer
+    int error = msync(map->base, map->length, MS_SYNC) == 0 ? 0 : errno;
+    if (error != 0) {
+        printf("Error writing the mapped image: %s\n", strerror(error));
+    }
+    if (munmap(map->base, map->length) != 0 && error == 0) {
+        error = errno;
+    }
+    return error == 0 ? 0 : -1;
+}
+#else
+int
+mapPPM(const char *filename, size_t width, size_t height, struct PPMMap *map)
+{
+    printf("Cannot map %s into memory: not supported on this system\n", filename);
+    return -1;
+}
+
+int
+unmapPPM(struct PPMMap *map)
 {
+    return -1;
+}
+#endif
+
+void exportPPM(const char *filename, struct PPM *image, int format)
+{
+    if (format != PPM_ASCII) {
+        FILE *img = beginPPM(filename, image->width, image->height);
+        int error = img == NULL;
+        if (!error) {
+            error = writePPMBand(img, image->data, image->width, image->height) != 0;
+            error |= endPPM(img) != 0;
+        }
+        if (error) {
+            printf("Error saving image!\n");
+        }
+        return;
+    }
+
 	FILE *img;
     img = fopen(filename, "w");
     if (img == NULL) {
@@ -25,10 +150,11 @@ void exportPPM(const char *filename, struct PPM *image)
         return;
     }
 
+    size_t row = (size_t)image->width * 3;
     fprintf(img, "P3 %d %d 255 ", image->width, image->height);;
     for(int y = image->height - 1; y >= 0; y--) {
-        for(int x = 0; x < image->width * 3; x++) {
-            fprintf(img, "%d\n",(int)(image->data[y * image->width * 3 + x]));
+        for(size_t x = 0; x < row; x++) {
+            fprintf(img, "%d\n",(int)(image->data[y * row + x]));
 		}
 	}
 	fclose(img);
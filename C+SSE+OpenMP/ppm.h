@@ -14,6 +14,24 @@
 #ifndef PPM_HEADER
 #define PPM_HEADER
 
+#include <stdio.h>
+#include <stddef.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+/*
+ * 1 where mapPPM can map files into memory (systems with POSIX mmap), 0
+ * elsewhere (e.g. Windows); there mapPPM always fails and the pictures have
+ * to be written with beginPPM and writePPMBand instead.
+ */
+#if defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES > 0
+#define PPM_MAPPED 1
+#else
+#define PPM_MAPPED 0
+#endif
+
 /*
  * Representation of an image.
  */
@@ -23,14 +41,100 @@ struct PPM {
 	unsigned char* data;
 };
 
+/*
+ * File formats for exportPPM.
+ */
+#define PPM_BINARY 0	// P6, the bytes as they are
+#define PPM_ASCII 1	// P3, one decimal number per byte
+
 /*
  * Saves a PPM file (3-channels, each 8-bit unsigned char) to disk into a file named path.
  * 
  * Arguments:
  *	filename - The filename including path for the image file.
  *	image - PPM structure containing width, height and actual data of an image.
+ *	format - PPM_BINARY (P6, written a row at a time) or PPM_ASCII (P3, much slower)
  */
 void
-exportPPM(const char *filename, struct PPM *image);
+exportPPM(const char *filename, struct PPM *image, int format);
+
+/*
+ * Starts a binary PPM file (P6) that is written band by band with
+ * writePPMBand, for pictures too large to be held in memory as a whole.
+ *
+ * Arguments:
+ *	filename - The filename including path for the image file.
+ *	width, height - Size of the whole picture in pixels.
+ *
+ * Returns:
+ *   The open file, NULL if it cannot be written.
+ */
+FILE *
+beginPPM(const char *filename, size_t width, size_t height);
+
+/*
+ * Appends a band of rows to a file started with beginPPM. Like exportPPM, the
+ * file holds the bottom row of the picture first, so the bands have to be
+ * written from the bottom of the picture to the top.
+ *
+ * Arguments:
+ *	img - The file from beginPPM.
+ *	data - RGB 8-bit values of the band in row-major order, top row first.
+ *	width - Width of the picture in pixels.
+ *	rows - Number of rows in the band.
+ *
+ * Returns:
+ *   0 on success, -1 if the rows cannot be written.
+ */
+int
+writePPMBand(FILE *img, const unsigned char *data, size_t width, size_t rows);
+
+/*
+ * Closes a file started with beginPPM.
+ *
+ * Returns:
+ *   0 on success, -1 if the last rows cannot be written.
+ */
+int
+endPPM(FILE *img);
+
+/*
+ * A binary PPM file mapped into memory by mapPPM.
+ */
+struct PPMMap {
+	void *base;		// start of the mapping (the header)
+	size_t length;		// size of the file in bytes
+	unsigned char *data;	// first pixel byte, the bottom row of the picture
+};
+
+/*
+ * Creates a binary PPM file (P6) at its final size (with posix_fallocate
+ * where available, so that a full disk is noticed here), writes the header and
+ * maps the file into memory, so that the pixels can be written in place at
+ * their final offsets and the page cache writes them back. Like exportPPM,
+ * the file holds the bottom row first: row y of the picture starts at
+ * data + (height - 1 - y) * width * 3.
+ *
+ * Arguments:
+ *	filename - The filename including path for the image file.
+ *	width, height - Size of the picture in pixels.
+ *	map - Receives the mapping.
+ *
+ * Returns:
+ *   0 on success, -1 if the file cannot be created at its size or mapped; the
+ *   reason is printed and the file is removed again. Always -1 without PPM_MAPPED.
+ */
+int
+mapPPM(const char *filename, size_t width, size_t height, struct PPMMap *map);
+
+/*
+ * Writes the pixels of a file mapped by mapPPM back to disk (msync) and
+ * unmaps it.
+ *
+ * Returns:
+ *   0 on success, -1 if the pixels could not be written back or unmapped.
+ */
+int
+unmapPPM(struct PPMMap *map);
 
 #endif /* PPM_HEADER */
@@ -0,0 +1,273 @@
+/*
+ *   Copyright (C) 2013 Daniel Thürck
+ *   Copyright (C) 2013 Stefan Schmidt
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+
+/*
+ * Work-Stealing über Kacheln: Die Kacheln werden in eine Reihenfolge gebracht,
+ * in der jeder Thread einen zusammenhängenden Bereich [begin, end) bekommt.
+ * Das ist seine Deque: der Besitzer nimmt vorne, Diebe nehmen die hintere
+ * Hälfte. Weil gestohlene Bereiche wieder zusammenhängend sind, braucht eine
+ * Deque nur zwei Zahlen und ein Lock. Die restliche Arbeit einer Deque ergibt
+ * sich aus den Präfixsummen der geschätzten Kosten.
+ */
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "scheduler.h"
+
+#ifdef _OPENMP
+
+struct Deque {
+	omp_lock_t lock;
+	int begin;        // nächste Position des Besitzers
+	int end;          // hinter der letzten Position, hier wird gestohlen
+};
+
+/*
+ * Eine Kachel mit ihren geschätzten Kosten, zum Sortieren
+ */
+struct CostedTile {
+	double cost;
+	int tile;
+};
+
+/*
+ * Vergleichsfunktion für qsort, teuerste Kachel zuerst
+ */
+static int
+compareCost(const void *a, const void *b)
+{
+	double ca = ((const struct CostedTile *)a)->cost;
+	double cb = ((const struct CostedTile *)b)->cost;
+	return (ca < cb) - (ca > cb);
+}
+
+/*
+ * Verteilt die Kacheln auf die Threads: ohne Kosten zusammenhängend in gleich großen
+ * Anteilen, mit Kosten teuerste zuerst jeweils an den Thread mit der wenigsten Arbeit
+ *
+ * Arguments:
+ *  count - Anzahl der Kacheln
+ *  costs - Geschätzte Kosten jeder Kachel oder NULL
+ *  threads - Anzahl der Threads
+ *  deques - Erhält den Anteil jedes Threads
+ *  order - Erhält die Kachel an jeder Position
+ *  prefix - Erhält die Summe der Kosten vor jeder Position (count + 1 Werte)
+ */
+static void
+dealTiles(int count, const double *costs, int threads, struct Deque *deques, int *order, double *prefix)
+{
+	if (costs == NULL)
+	{
+		for (int i = 0; i < threads; i++)
+		{
+			deques[i].begin = (long)count * i / threads;
+			deques[i].end = (long)count * (i + 1) / threads;
+		}
+		for (int p = 0; p <= count; p++)
+		{
+			if (p < count)
+				order[p] = p;
+			prefix[p] = p;
+		}
+		return;
+	}
+
+	struct CostedTile *sorted = malloc(count * sizeof(struct CostedTile));
+	int *owner = malloc(count * sizeof(int));
+	int *size = calloc(threads, sizeof(int));
+	double *load = calloc(threads, sizeof(double));
+
+	for (int k = 0; k < count; k++)
+	{
+		sorted[k].cost = costs[k];
+		sorted[k].tile = k;
+	}
+	qsort(sorted, count, sizeof(struct CostedTile), compareCost);
+
+	// Teuerste Kachel zuerst an den Thread mit der geringsten Last
+	for (int k = 0; k < count; k++)
+	{
+		int least = 0;
+		for (int i = 1; i < threads; i++)
+			if (load[i] < load[least])
+				least = i;
+		load[least] += sorted[k].cost;
+		owner[k] = least;
+		size[least]++;
+	}
+
+	// Die Anteile hintereinander ablegen, innerhalb eines Anteils bleibt die absteigende Reihenfolge erhalten
+	int position = 0;
+	for (int i = 0; i < threads; i++)
+	{
+		deques[i].begin = position;
+		deques[i].end = position;
+		position += size[i];
+	}
+	for (int k = 0; k < count; k++)
+		order[deques[owner[k]].end++] = sorted[k].tile;
+
+	prefix[0] = 0;
+	for (int p = 0; p < count; p++)
+		prefix[p + 1] = prefix[p] + costs[order[p]];
+
+	free(load);
+	free(size);
+	free(owner);
+	free(sorted);
+}
+
+/*
+ * Nimmt die vorderste Kachel aus der eigenen Deque
+ *
+ * Returns:
+ *  Position der Kachel, -1 wenn die Deque leer ist
+ */
+static int
+popTile(struct Deque *deque)
+{
+	int tile = -1;
+
+	omp_set_lock(&deque->lock);
+	if (deque->begin < deque->end)
+		tile = deque->begin++;
+	omp_unset_lock(&deque->lock);
+
+	return tile;
+}
+
+/*
+ * Stiehlt die hintere Hälfte der Deque mit der meisten verbleibenden Arbeit
+ * und legt sie in die (leere) eigene Deque
+ *
+ * Arguments:
+ *  deques - Die Deques aller Threads
+ *  threads - Anzahl der Deques
+ *  self - Index der eigenen Deque
+ *  prefix - Summe der geschätzten Kosten vor jeder Position
+ *
+ * Returns:
+ *  1 wenn etwas gestohlen wurde, 0 wenn keine Kacheln mehr übrig sind
+ */
+static int
+stealTiles(struct Deque *deques, int threads, int self, const double *prefix)
+{
+	while (1)
+	{
+		int victim = -1;
+		double most = 0;
+
+		for (int i = 0; i < threads; i++)
+		{
+			omp_set_lock(&deques[i].lock);
+			int begin = deques[i].begin;
+			int end = deques[i].end;
+			omp_unset_lock(&deques[i].lock);
+
+			// Kacheln ohne geschätzte Kosten zählen trotzdem als Arbeit
+			if (begin < end && (victim < 0 || prefix[end] - prefix[begin] > most))
+			{
+				most = prefix[end] - prefix[begin];
+				victim = i;
+			}
+		}
+
+		if (victim < 0)
+			return 0;
+
+		// Zwischen Suche und Diebstahl kann die Deque schon leer geworden sein, dann neu suchen
+		int begin = 0;
+		int end = 0;
+		omp_set_lock(&deques[victim].lock);
+		int remaining = deques[victim].end - deques[victim].begin;
+		if (remaining > 0)
+		{
+			end = deques[victim].end;
+			begin = end - (remaining + 1) / 2;
+			deques[victim].end = begin;
+		}
+		omp_unset_lock(&deques[victim].lock);
+
+		if (begin < end)
+		{
+			omp_set_lock(&deques[self].lock);
+			deques[self].begin = begin;
+			deques[self].end = end;
+			omp_unset_lock(&deques[self].lock);
+			return 1;
+		}
+	}
+}
+
+void
+runTiles(
+    int count,
+    const double *costs,
+    tileFunc work,
+    void *data)
+{
+    const int threads = omp_get_max_threads();
+    struct Deque *deques = malloc(threads * sizeof(struct Deque));
+    int *order = malloc(count * sizeof(int));
+    double *prefix = malloc((count + 1) * sizeof(double));
+
+    // Jeder Thread beginnt mit einem zusammenhängenden Anteil der Kacheln
+    dealTiles(count, costs, threads, deques, order, prefix);
+    for(int i = 0; i < threads; i++) {
+        omp_init_lock(&deques[i].lock);
+    }
+
+    // Bekommt die Region weniger Threads als angefordert, werden die übrigen Deques gestohlen
+    #pragma omp parallel num_threads(threads)
+    {
+        const int self = omp_get_thread_num();
+
+        while(1) {
+            int position = popTile(&deques[self]);
+            if(position >= 0) {
+                work(order[position], data);
+            } else if(!stealTiles(deques, threads, self, prefix)) {
+                break;
+            }
+        }
+    }
+
+    for(int i = 0; i < threads; i++) {
+        omp_destroy_lock(&deques[i].lock);
+    }
+    free(prefix);
+    free(order);
+    free(deques);
+}
+
+#else
+
+void
+runTiles(
+    int count,
+    const double *costs,
+    tileFunc work,
+    void *data)
+{
+    // Ohne OpenMP gibt es nur einen Thread, der alle Kacheln der Reihe nach bearbeitet
+    for(int tile = 0; tile < count; tile++) {
+        work(tile, data);
+    }
+}
+
+#endif /* _OPENMP */
@@ -0,0 +1,60 @@
+/*   Copyright (C) 2013 Daniel Thürck
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+#ifndef SCHEDULER_HEADER
+#define SCHEDULER_HEADER
+
+/*
+ * Rectangle of pixels of a view.
+ */
+struct Tile {
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+/*
+ * Processes one tile.
+ *
+ * Arguments:
+ *	tile - Index of the tile
+ *	data - The pointer passed to runTiles
+ */
+typedef void (*tileFunc)(int tile, void *data);
+
+/*
+ * Processes count tiles with all OpenMP threads. Every thread starts with its
+ * own share of the tiles in a deque and takes them from the front. A thread
+ * that runs out of tiles steals the back half of the deque with the most work
+ * left, so expensive tiles do not leave a single thread running while the
+ * others idle.
+ *
+ * With estimated costs, the tiles are dealt out so that every thread gets
+ * about the same total cost, and every thread works on its most expensive
+ * tiles first. Thieves then take the cheap tiles from the back.
+ *
+ * Arguments:
+ *	count - Number of tiles
+ *	costs - Estimated cost of every tile, NULL if nothing is known
+ *	work - Function that processes a tile
+ *	data - Passed on to work
+ */
+void
+runTiles(
+    int count,
+    const double *costs,
+    tileFunc work,
+    void *data);
+
+#endif /* SCHEDULER_HEADER */
@@ -0,0 +1,163 @@
+/*
+ *   Copyright (C) 2013 Daniel Thürck
+ *   Copyright (C) 2013 Stefan Schmidt
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+
+/*
+ * Unterteilung nach Mariani-Silver: Die Mandelbrotmenge ist zusammenhängend, ein
+ * Rechteck, dessen Rand vollständig in der Menge liegt (bzw. überall die gleiche
+ * Iterationszahl hat), hat innen die gleiche Iterationszahl. Gerade die teuren
+ * Pixel im Inneren der Menge müssen so nicht iteriert werden.
+ *
+ * Rechtecke werden mit ihren Eckpixeln angegeben (einschließlich), ihr Rand ist
+ * beim Aufruf von subdivide schon berechnet. Benachbarte Rechtecke teilen sich
+ * eine Randlinie.
+ */
+#include <stdlib.h>
+
+#include "subdivision.h"
+
+// Rechtecke mit weniger Pixeln pro Seite werden ohne weitere Unterteilung berechnet
+#define SUBDIVISION_MIN_SIZE 16
+
+/*
+ * Berechnet einen waagrechten Abschnitt
+ *
+ * Arguments:
+ *  x0, x1 - Erster und letzter Pixel des Abschnitts
+ *  y - Zeile
+ */
+static void
+computeRow(escapeRunFunc escapeRun, const struct Viewport *view, int maxIterations, int x0, int x1, int y, float *iterations)
+{
+	if (x1 >= x0)
+		escapeRun(view, maxIterations, x0, y, 1, 0, x1 - x0 + 1, iterations + (size_t)y * view->width + x0);
+}
+
+/*
+ * Berechnet einen senkrechten Abschnitt
+ *
+ * Arguments:
+ *  x - Spalte
+ *  y0, y1 - Erster und letzter Pixel des Abschnitts
+ */
+static void
+computeColumn(escapeRunFunc escapeRun, const struct Viewport *view, int maxIterations, int x, int y0, int y1, float *iterations)
+{
+	if (y1 < y0)
+		return;
+
+	// Die Kernel schreiben zusammenhängend, die Spalte wird danach einsortiert
+	int count = y1 - y0 + 1;
+	float *column = malloc(count * sizeof(float));
+
+	escapeRun(view, maxIterations, x, y0, 0, 1, count, column);
+	for (int i = 0; i < count; i++)
+		iterations[(size_t)(y0 + i) * view->width + x] = column[i];
+
+	free(column);
+}
+
+/*
+ * Prüft, ob alle Randpixel eines Rechtecks die gleiche Iterationszahl haben
+ *
+ * Returns:
+ *  1 wenn der Rand einheitlich ist, sonst 0
+ */
+static int
+uniformBorder(const struct Viewport *view, int x0, int y0, int x1, int y1, const float *iterations)
+{
+	const int width = view->width;
+	const float value = iterations[(size_t)y0 * width + x0];
+
+	for (int x = x0; x <= x1; x++)
+		if (iterations[(size_t)y0 * width + x] != value || iterations[(size_t)y1 * width + x] != value)
+			return 0;
+
+	for (int y = y0 + 1; y < y1; y++)
+		if (iterations[(size_t)y * width + x0] != value || iterations[(size_t)y * width + x1] != value)
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Füllt das Innere eines Rechtecks oder unterteilt es weiter
+ *
+ * Arguments:
+ *  x0, y0 - Linker oberer Pixel des Rechtecks
+ *  x1, y1 - Rechter unterer Pixel des Rechtecks
+ */
+static void
+subdivide(escapeRunFunc escapeRun, const struct Viewport *view, int maxIterations, int x0, int y0, int x1, int y1, float *iterations)
+{
+	const int width = view->width;
+
+	if (uniformBorder(view, x0, y0, x1, y1, iterations))
+	{
+		const float value = iterations[(size_t)y0 * width + x0];
+		for (int y = y0 + 1; y < y1; y++)
+			for (int x = x0 + 1; x < x1; x++)
+				iterations[(size_t)y * width + x] = value;
+		return;
+	}
+
+	// Kleine Rechtecke lohnen die Unterteilung nicht mehr
+	if (x1 - x0 < SUBDIVISION_MIN_SIZE || y1 - y0 < SUBDIVISION_MIN_SIZE)
+	{
+		for (int y = y0 + 1; y < y1; y++)
+			computeRow(escapeRun, view, maxIterations, x0 + 1, x1 - 1, y, iterations);
+		return;
+	}
+
+	// Mittellinien berechnen, sie sind der gemeinsame Rand der vier Teile
+	const int xm = (x0 + x1) / 2;
+	const int ym = (y0 + y1) / 2;
+	computeRow(escapeRun, view, maxIterations, x0 + 1, x1 - 1, ym, iterations);
+	computeColumn(escapeRun, view, maxIterations, xm, y0 + 1, ym - 1, iterations);
+	computeColumn(escapeRun, view, maxIterations, xm, ym + 1, y1 - 1, iterations);
+
+	// Die Teile schreiben nur in ihr eigenes Inneres und können parallel laufen
+	#pragma omp task
+	subdivide(escapeRun, view, maxIterations, x0, y0, xm, ym, iterations);
+	#pragma omp task
+	subdivide(escapeRun, view, maxIterations, xm, y0, x1, ym, iterations);
+	#pragma omp task
+	subdivide(escapeRun, view, maxIterations, x0, ym, xm, y1, iterations);
+	#pragma omp task
+	subdivide(escapeRun, view, maxIterations, xm, ym, x1, y1, iterations);
+}
+
+void
+iterateSubdivision(
+    escapeRunFunc escapeRun,
+    const struct Viewport *view,
+    int maxIterations,
+    float *iterations)
+{
+    const int width = view->width;
+    const int height = view->height;
+
+    #pragma omp parallel
+    #pragma omp single
+    {
+        // Rand des ganzen Bildes, das Innere wird unterteilt
+        computeRow(escapeRun, view, maxIterations, 0, width - 1, 0, iterations);
+        computeRow(escapeRun, view, maxIterations, 0, width - 1, height - 1, iterations);
+        computeColumn(escapeRun, view, maxIterations, 0, 1, height - 2, iterations);
+        computeColumn(escapeRun, view, maxIterations, width - 1, 1, height - 2, iterations);
+
+        subdivide(escapeRun, view, maxIterations, 0, 0, width - 1, height - 1, iterations);
+    }
+}
@@ -0,0 +1,38 @@
+/*   Copyright (C) 2013 Daniel Thürck
+
+ *   This program is free software; you can redistribute it and/or modify it under the terms of the
+ *   GNU General Public License as published by the Free Software Foundation; either version 2 of
+ *   the License, or (at your option) any later version.
+
+ *   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *   without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *   See the GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License along with this program;
+ *   if not, write to the Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110, USA
+ */
+#ifndef SUBDIVISION_HEADER
+#define SUBDIVISION_HEADER
+
+#include "kernel.h"
+
+/*
+ * Iterates a view by recursive rectangle subdivision (Mariani-Silver): only
+ * the border of a rectangle is iterated. If all border pixels have the same
+ * iteration number, the inside is filled with it, otherwise the rectangle is
+ * split in four and the parts are processed as OpenMP tasks.
+ *
+ * Arguments:
+ *	escapeRun - The kernel that iterates the pixels
+ *	view - The viewport that is rendered
+ *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
+ *	iterations - Array of width * height ints that receives the (smoothed) iteration numbers in row-major order
+ */
+void
+iterateSubdivision(
+    escapeRunFunc escapeRun,
+    const struct Viewport *view,
+    int maxIterations,
+    float *iterations);
+
+#endif /* SUBDIVISION_HEADER */
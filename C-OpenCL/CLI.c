@@ -15,6 +15,7 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <getopt.h>
 
@@ -22,14 +23,24 @@
 #include "mandelbrot.h"
 #include "ppm.h"
 
+// names of the formulas for --formula, indexed by the FORMULA_ constants
+static const char *formulaNames[] = {"mandelbrot", "julia", "multibrot3", "multibrot4", "burningship"};
+#define FORMULA_NAME_COUNT (int)(sizeof(formulaNames) / sizeof(formulaNames[0]))
+
 struct arguments {
     int maxIterations;
     char * outfile;
+    int formula;
+    complex float seed;
+    int format;
 };
 
 static struct option long_options[] = {
     {"maxiterations", required_argument, 0, 'i'},
     {"outfile", required_argument, 0, 'o'},
+    {"formula", required_argument, 0, 'f'},
+    {"seed", required_argument, 0, 'c'},
+    {"ascii", no_argument, 0, 'A'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
 };
@@ -41,6 +52,9 @@ help(void)
     printf("With [OPTIONS]:\n");
     printf("\t -i --maxiterations INT \t maximum number of series iterations per pixel\n");
     printf("\t -o --outfile FILE \t filename (without appendix) for output picture in PPM format\n");
+    printf("\t -f --formula NAME \t iterate mandelbrot (default), julia, multibrot3 (z^3 + c), multibrot4 (z^4 + c) or burningship\n");
+    printf("\t -c --seed RE,IM \t constant c of the Julia set (default -0.8,0.156)\n");
+    printf("\t -A --ascii \t\t write the picture as ASCII PPM (P3) instead of binary (P6)\n");
     printf("\n");
 }
 
@@ -55,12 +69,15 @@ main(int argc, char *argv[])
     struct arguments args;
     args.maxIterations = 100;
     args.outfile = "mandelbrot.ppm";
+    args.formula = FORMULA_MANDELBROT;
+    args.seed = DEFAULT_JULIA_SEED;
+    args.format = PPM_BINARY;
     int c = 0;
 
     while(1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "hi:o:", long_options, &option_index);
+        c = getopt_long(argc, argv, "hi:o:f:c:A", long_options, &option_index);
 
         // exit loop after parsing all arguments
         if(c == -1) {
@@ -86,12 +103,40 @@ main(int argc, char *argv[])
                 args.outfile = optarg;
                 printf("Result file: %s\n", args.outfile);
                 break;
+            case 'f':
+                args.formula = -1;
+                for(int f = 0; f < FORMULA_NAME_COUNT; f++) {
+                    if(strcmp(optarg, formulaNames[f]) == 0) {
+                        args.formula = f;
+                    }
+                }
+                if(args.formula < 0) {
+                    printf("Unknown formula %s, terminating...\n", optarg);
+                    exit(-1);
+                }
+                printf("Formula: %s\n", formulaNames[args.formula]);
+                break;
+            case 'c': {
+                float re = 0;
+                float im = 0;
+                if(sscanf(optarg, "%f,%f", &re, &im) < 2) {
+                    printf("Invalid Julia seed %s, terminating...\n", optarg);
+                    exit(-1);
+                }
+                args.seed = re + im * I;
+                printf("Julia seed: %g%+gi\n", re, im);
+                break;
+            }
+            case 'A':
+                args.format = PPM_ASCII;
+                break;
             default:
                 printf("Unknown option, terminating...\n");
                 exit(-1);
         }
     }
 	
+	setMandelbrotFormula(args.formula, args.seed);
 	initMandelbrot();
 
     gettimeofday(&start, 0);
@@ -106,7 +151,7 @@ main(int argc, char *argv[])
     image.width = WIDTH;
     image.height = HEIGHT;
     image.data = data;
-    exportPPM(args.outfile, &image);
+    exportPPM(args.outfile, &image, args.format);
 
     return 0;
 }
@@ -18,6 +18,12 @@
 #define WIDTH 1024
 #define HEIGHT 768
 #define RADIUS 2
+#define FORMULA_MANDELBROT 0
+#define FORMULA_JULIA 1
+#define FORMULA_MULTIBROT3 2
+#define FORMULA_MULTIBROT4 3
+#define FORMULA_BURNING_SHIP 4
+#define DEFAULT_JULIA_SEED (-0.8f+0.156f*I)
 #define ZOOM 0.4f
 #define INITIAL_UPPERLEFT (-2.5+1.5*I)
 #define INITIAL_LOWERRIGHT (1-1.5*I)
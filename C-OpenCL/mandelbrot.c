@@ -21,6 +21,17 @@ cl_kernel kernel;
 cl_command_queue queue;
 cl_context context;
 
+// Formel, mit der initMandelbrot den Kernel übersetzt
+static int formula = FORMULA_MANDELBROT;
+static complex float juliaSeed = DEFAULT_JULIA_SEED;
+
+void
+setMandelbrotFormula(int type, complex float seed)
+{
+    formula = type;
+    juliaSeed = seed;
+}
+
 void initMandelbrot ()
 {
     cl_platform_id platform;
@@ -51,36 +62,68 @@ void initMandelbrot ()
     }
     const char* sourceptr = source;
     cl_program program = clCreateProgramWithSource(context, 1, &sourceptr, NULL, NULL);
-    clBuildProgram(program, 1, &device, NULL, NULL, NULL);
+    // Formel und Julia-Konstante sind Konstanten im Kernel, der Compiler lässt die anderen Formeln weg
+    char options[128];
+    snprintf(options, sizeof(options), "-D FORMULA=%d -D SEED_RE=((float)%.9g) -D SEED_IM=((float)%.9g)",
+             formula, crealf(juliaSeed), cimagf(juliaSeed));
+    clBuildProgram(program, 1, &device, options, NULL, NULL);
     kernel = clCreateKernel(program, "mandelbrot", NULL);
     free(source);
 }
 
 /*
- * Generates an image of a Mandelbrot set.
+ * Renders a tile of a view into a caller-provided buffer.
  */
-unsigned char *
-generateMandelbrot(
+void
+renderMandelbrotTile(
     complex float upperLeft,
     complex float lowerRight,
     int maxIterations,
     int width,
-    int height)
+    int height,
+    int tileX,
+    int tileY,
+    int tileWidth,
+    int tileHeight,
+    unsigned char *image,
+    size_t stride)
 {
-    cl_mem buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, width*height*3, NULL, NULL);
+    // Der Kernel schreibt die Kachel zusammenhängend, beim Zurücklesen wird sie mit stride einsortiert
+    cl_mem buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, tileWidth*tileHeight*3, NULL, NULL);
+    cl_float2 clUpperLeft = {{crealf(upperLeft), cimagf(upperLeft)}};
+    cl_float2 clSpan = {{crealf(lowerRight) - crealf(upperLeft), cimagf(lowerRight) - cimagf(upperLeft)}};
     clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffer);
     clSetKernelArg(kernel, 1, sizeof(width), &width);
     clSetKernelArg(kernel, 2, sizeof(height), &height);
     static const float radius = RADIUS;
     clSetKernelArg(kernel, 3, sizeof(radius), &radius);
     clSetKernelArg(kernel, 4, sizeof(maxIterations), &maxIterations);
+    clSetKernelArg(kernel, 5, sizeof(clUpperLeft), &clUpperLeft);
+    clSetKernelArg(kernel, 6, sizeof(clSpan), &clSpan);
+    clSetKernelArg(kernel, 7, sizeof(tileX), &tileX);
+    clSetKernelArg(kernel, 8, sizeof(tileY), &tileY);
 
-    const size_t globalWorkSize[] = {width, height, 0, 0};
+    const size_t globalWorkSize[] = {tileWidth, tileHeight, 0, 0};
     clEnqueueNDRangeKernel(queue, kernel, 2, NULL, globalWorkSize, NULL, 0, NULL, NULL);
 
-    unsigned char *image = malloc(height * width * 3);
+    const size_t origin[] = {0, 0, 0};
+    const size_t region[] = {tileWidth*3, tileHeight, 1};
+    clEnqueueReadBufferRect(queue, buffer, CL_TRUE, origin, origin, region, tileWidth*3, 0, stride, 0, image, 0, NULL, NULL);
+    clReleaseMemObject(buffer);
+}
 
-    clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0, width*height*3, image, 0, NULL, NULL);
+/*
+ * Generates an image of a Mandelbrot set.
+ */
+unsigned char *
+generateMandelbrot(
+    complex float upperLeft,
+    complex float lowerRight,
+    int maxIterations,
+    int width,
+    int height)
+{
+    unsigned char *image = malloc((size_t)width * height * 3);
+    renderMandelbrotTile(upperLeft, lowerRight, maxIterations, width, height, 0, 0, width, height, image, width * 3);
     return image;
 }
-
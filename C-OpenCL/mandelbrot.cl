@@ -1,8 +1,47 @@
+// Die Formel wird beim Übersetzen festgelegt (-D FORMULA=..., siehe initMandelbrot), jede bekommt ihren eigenen Kernel
+#define FORMULA_MANDELBROT 0
+#define FORMULA_JULIA 1
+#define FORMULA_MULTIBROT3 2
+#define FORMULA_MULTIBROT4 3
+#define FORMULA_BURNING_SHIP 4
+
+#ifndef FORMULA
+#define FORMULA FORMULA_MANDELBROT
+#endif
+
+// Die Konstante c der Julia-Menge, ebenfalls aus den Build-Optionen
+#ifndef SEED_RE
+#define SEED_RE 0.0f
+#define SEED_IM 0.0f
+#endif
+
+#if FORMULA == FORMULA_MULTIBROT3
+#define DEGREE 3.0f
+#elif FORMULA == FORMULA_MULTIBROT4
+#define DEGREE 4.0f
+#else
+#define DEGREE 2.0f
+#endif
+
 float2 complex_sqr (const float2 a)
 {
 	return (float2) (a.x*a.x - a.y*a.y, a.x*a.y + a.y*a.x);
 }
 
+// Ein Schritt der Folge ohne das + c
+float2 formula_step (const float2 z)
+{
+#if FORMULA == FORMULA_MULTIBROT3
+	return (float2) (z.x*(z.x*z.x - 3.0f*z.y*z.y), z.y*(3.0f*z.x*z.x - z.y*z.y));
+#elif FORMULA == FORMULA_MULTIBROT4
+	return complex_sqr(complex_sqr(z));
+#elif FORMULA == FORMULA_BURNING_SHIP
+	return complex_sqr(fabs(z));
+#else
+	return complex_sqr(z);
+#endif
+}
+
 void colorMapYUV (const float index, const float maxIterations, __global uchar* color)
 {
 	// Wenn die komplexe Zahl Teil der Mandelbrotmenge ist, wird sie schwarz eingefärbt
@@ -29,26 +68,52 @@ void colorMapYUV (const float index, const float maxIterations, __global uchar*
 	color[2] = (char) (b*255.0f);
 }
 
-__kernel void mandelbrot (__global uchar* outImage, const int width, const int height, const float radius, const int iterations)
+// Punkte in der Hauptkardioide und im Kreis der Periode 2 liegen sicher in der Mandelbrotmenge
+int insideCardioidOrBulb (const float2 c)
+{
+	const float im2 = c.y*c.y;
+	const float xq = c.x - 0.25f;
+	const float q = xq*xq + im2;
+	const float xb = c.x + 1.0f;
+	return q*(q + xq) <= 0.25f*im2 || xb*xb + im2 <= 0.0625f;
+}
+
+// Jedes Work-Item berechnet einen Pixel der Kachel (tileX, tileY) des Ausschnitts, die Kachel liegt zusammenhängend in outImage
+__kernel void mandelbrot (__global uchar* outImage, const int width, const int height, const float radius, const int iterations,
+                          const float2 upperLeft, const float2 span, const int tileX, const int tileY)
 {
-	const int x = get_global_id(0);
-	const int y = get_global_id(1);
+	const int tx = get_global_id(0);
+	const int ty = get_global_id(1);
+	const int x = tileX + tx;
+	const int y = tileY + ty;
 	
 	float2 z = (float2)(0.0f, 0.0f);
-	float2 c = (float2)(-2.5f, 1.5f);
-	c += (float2)(x*(1-(-2.5f))/width, y*(-1.5f-1.5f)/height);
-	int i=0;
+	float2 c = upperLeft;
+	c += (float2)(x*span.x/width, y*span.y/height);
+	
+#if FORMULA == FORMULA_JULIA
+	// Bei Julia-Mengen ist der Punkt z_0 und c für alle gleich
+	z = c;
+	c = (float2)(SEED_RE, SEED_IM);
+#endif
+
+#if FORMULA == FORMULA_MANDELBROT
+	// Für Punkte in Kardioide und Kreis wird die Schleife gar nicht erst betreten
+	int i = insideCardioidOrBulb(c) ? iterations : 0;
+#else
+	int i = 0;
+#endif
 	
 	while ((length(z) <= (radius)) && (i<iterations))
 	{
-		z = complex_sqr(z) + c;
+		z = formula_step(z) + c;
 		i++;
 	}
 	
 	if (i < iterations)
 	{
-		i += 1.0f - (log(log(length(z)) / log(2.0f)) / log(2.0f));
+		i += 1.0f - (log(log(length(z)) / log(2.0f)) / log(DEGREE));
 	}
 	
-	colorMapYUV(i, iterations, outImage+((y*width+x)*3));
+	colorMapYUV(i, iterations, outImage+((ty*get_global_size(0)+tx)*3));
 }
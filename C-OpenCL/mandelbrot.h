@@ -44,6 +44,45 @@ generateMandelbrot(
     int width,
     int height);
 
+/*
+ * Renders the tile of tileWidth times tileHeight pixels starting at pixel
+ * (tileX, tileY) of the view into a buffer the caller owns. Pixel (x, y) of
+ * the tile gets the same color as pixel (tileX + x, tileY + y) of
+ * generateMandelbrot.
+ *
+ * Arguments:
+ *	upperLeft, lowerRight, maxIterations, width, height - The whole view, see generateMandelbrot
+ *	tileX, tileY - First pixel of the tile
+ *	tileWidth, tileHeight - Size of the tile in pixels
+ *	image - Receives the RGB 8-bit values of the tile
+ *	stride - Distance between two rows of the tile in image in bytes (at least tileWidth * 3)
+ */
+void
+renderMandelbrotTile(
+    complex float upperLeft,
+    complex float lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int tileX,
+    int tileY,
+    int tileWidth,
+    int tileHeight,
+    unsigned char *image,
+    size_t stride);
+
+/*
+ * Selects the series the kernel iterates (one of the FORMULA_ constants of
+ * globals.h). The formula is compiled into the kernel, so it has to be set
+ * before initMandelbrot.
+ *
+ * Arguments:
+ *	formula - The formula, FORMULA_MANDELBROT by default
+ *	seed - The constant c of FORMULA_JULIA, ignored by the others
+ */
+void
+setMandelbrotFormula(int formula, complex float seed);
+
 void initMandelbrot();
 
 #endif /* MANDELBROT_HEADER */
@@ -16,8 +16,51 @@
 
 #include "ppm.h"
 
-void exportPPM(const char *filename, struct PPM *image)
+FILE *
+beginPPM(const char *filename, size_t width, size_t height)
 {
+    FILE *img = fopen(filename, "wb");
+    if (img != NULL && fprintf(img, "P6\n%zu %zu\n255\n", width, height) < 0) {
+        fclose(img);
+        return NULL;
+    }
+    return img;
+}
+
+int
+writePPMBand(FILE *img, const unsigned char *data, size_t width, size_t rows)
+{
+    // Zeilen am Stück schreiben, von unten nach oben wie die ganze Datei
+    size_t row = width * 3;
+    for (size_t y = rows; y > 0; y--) {
+        if (fwrite(data + (y - 1) * row, 1, row, img) != row) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int
+endPPM(FILE *img)
+{
+    return fclose(img) == 0 ? 0 : -1;
+}
+
+void exportPPM(const char *filename, struct PPM *image, int format)
+{
+    if (format != PPM_ASCII) {
+        FILE *img = beginPPM(filename, image->width, image->height);
+        int error = img == NULL;
+        if (!error) {
+            error = writePPMBand(img, image->data, image->width, image->height) != 0;
+            error |= endPPM(img) != 0;
+        }
+        if (error) {
+            printf("Error saving image!\n");
+        }
+        return;
+    }
+
 	FILE *img;
     img = fopen(filename, "w");
     if (img == NULL) {
@@ -25,10 +68,11 @@ void exportPPM(const char *filename, struct PPM *image)
         return;
     }
 
+    size_t row = (size_t)image->width * 3;
     fprintf(img, "P3 %d %d 255 ", image->width, image->height);;
     for(int y = image->height - 1; y >= 0; y--) {
-        for(int x = 0; x < image->width * 3; x++) {
-            fprintf(img, "%d\n",(int)(image->data[y * image->width * 3 + x]));
+        for(size_t x = 0; x < row; x++) {
+            fprintf(img, "%d\n",(int)(image->data[y * row + x]));
 		}
 	}
 	fclose(img);
@@ -25,11 +25,15 @@
 struct arguments {
     int maxIterations;
     char * outfile;
+    int distance;
+    int format;
 };
 
 static struct option long_options[] = {
     {"maxiterations", required_argument, 0, 'i'},
     {"outfile", required_argument, 0, 'o'},
+    {"distance", no_argument, 0, 'e'},
+    {"ascii", no_argument, 0, 'A'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
 };
@@ -41,6 +45,8 @@ help(void)
     printf("With [OPTIONS]:\n");
     printf("\t -i --maxiterations INT \t maximum number of series iterations per pixel\n");
     printf("\t -o --outfile FILE \t filename (without appendix) for output picture in PPM format\n");
+    printf("\t -e --distance \t\t render the distance estimate instead of iteration counts\n");
+    printf("\t -A --ascii \t\t write the picture as ASCII PPM (P3) instead of binary (P6)\n");
     printf("\n");
 }
 
@@ -55,12 +61,14 @@ main(int argc, char *argv[])
     struct arguments args;
     args.maxIterations = 100;
     args.outfile = "mandelbrot.ppm";
+    args.distance = 0;
+    args.format = PPM_BINARY;
     int c = 0;
 
     while(1) {
         int option_index = 0;
 
-        c = getopt_long(argc, argv, "hi:o:", long_options, &option_index);
+        c = getopt_long(argc, argv, "hi:o:eA", long_options, &option_index);
 
         // exit loop after parsing all arguments
         if(c == -1) {
@@ -86,25 +94,46 @@ main(int argc, char *argv[])
                 args.outfile = optarg;
                 printf("Result file: %s\n", args.outfile);
                 break;
+            case 'e':
+                args.distance = 1;
+                printf("Using distance estimation\n");
+                break;
+            case 'A':
+                args.format = PPM_ASCII;
+                break;
             default:
                 printf("Unknown option, terminating...\n");
                 exit(-1);
         }
     }
 
+    // iterating and colouring are separate stages, the iteration field could be kept and coloured again
+    gettimeofday(&start, 0);
+    float *iterations = args.distance
+        ? estimateMandelbrotDistance(INITIAL_UPPERLEFT, INITIAL_LOWERRIGHT, args.maxIterations, WIDTH, HEIGHT, 1)
+        : iterateMandelbrot(INITIAL_UPPERLEFT, INITIAL_LOWERRIGHT, args.maxIterations, WIDTH, HEIGHT);
+    gettimeofday(&stop, 0);
+    long iterationTime = (stop.tv_sec-start.tv_sec)*1000 + (stop.tv_usec-start.tv_usec)/1000;
+
     gettimeofday(&start, 0);
-    unsigned char *data = generateMandelbrot(INITIAL_UPPERLEFT, INITIAL_LOWERRIGHT, args.maxIterations, WIDTH, HEIGHT);
+    unsigned char *data = args.distance
+        ? colorizeDistance(iterations, WIDTH, HEIGHT)
+        : colorizeMandelbrot(iterations, args.maxIterations, WIDTH, HEIGHT);
     gettimeofday(&stop, 0);
+    long colorTime = (stop.tv_sec-start.tv_sec)*1000 + (stop.tv_usec-start.tv_usec)/1000;
 
-    long renderTime = (stop.tv_sec-start.tv_sec)*1000 + (stop.tv_usec-start.tv_usec)/1000;
-    printf("Rendering took %ld ms...\n", renderTime);
+    printf("Iterating took %ld ms, colouring took %ld ms...\n", iterationTime, colorTime);
+    printf("Rendering took %ld ms...\n", iterationTime + colorTime);
 
     printf("Writing image...\n");
     struct PPM image;
     image.width = WIDTH;
     image.height = HEIGHT;
     image.data = data;
-    exportPPM(args.outfile, &image);
+    exportPPM(args.outfile, &image, args.format);
+
+    free(iterations);
+    free(data);
 
     return 0;
 }
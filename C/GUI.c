@@ -58,14 +58,15 @@ GtkWidget *hbButtons;
 pthread_t t;
 
 // functional values
-complex float upperLeft = INITIAL_UPPERLEFT;
-complex float lowerRight = INITIAL_LOWERRIGHT;
+complex double upperLeft = INITIAL_UPPERLEFT;
+complex double lowerRight = INITIAL_LOWERRIGHT;
 int iLevel = 0;
-int iLevelMax = 16;
+int iLevelMax = 30; // generateMandelbrot switches to double precision on its own, this is about where double ends
 int maxIterations = 100;
 gboolean rerender = FALSE;
 gboolean rendering = FALSE;
 
+float *field;          // iteration field of the current view, kept to colour it again without iterating
 unsigned char *buffer;
 GdkPixbuf *image;
 
@@ -232,17 +233,18 @@ bReset_clicked(GtkWidget * widget, gpointer data)
 void 
 evImageBox_clicked(GtkWidget * widget, GdkEventButton *event, gpointer data)
 {
-    if(rerender && !rendering) {
+    if(rerender && !rendering && iLevel < iLevelMax) {
         maxIterations = (int) gtk_range_get_value(GTK_RANGE(hscMaxIterations));
         
-        float spanX = crealf(lowerRight) - crealf(upperLeft);
-        float spanY = cimagf(upperLeft) - cimagf(lowerRight);
+        double spanX = creal(lowerRight) - creal(upperLeft);
+        double spanY = cimag(upperLeft) - cimag(lowerRight);
 
-        float centerX = crealf(upperLeft) + event->x/WIDTH * spanX;
-        float centerY = cimagf(lowerRight) + (HEIGHT - event->y)/HEIGHT * spanY;
+        double centerX = creal(upperLeft) + event->x/WIDTH * spanX;
+        double centerY = cimag(lowerRight) + (HEIGHT - event->y)/HEIGHT * spanY;
 
         upperLeft = (centerX - ZOOM/2 * spanX) + (centerY + ZOOM/2 * spanY) * I;
         lowerRight = (centerX + ZOOM/2 * spanX) + (centerY - ZOOM/2 * spanY) * I;
+        iLevel++;
 
         GUIrender();
     }
@@ -259,6 +261,7 @@ GUIrender(void)
         gtk_widget_set_sensitive(GTK_WIDGET(hscMaxIterations), FALSE);
     
         if(rerender) {
+            free(field);
             free(buffer);
             gtk_image_clear(GTK_IMAGE(imgSet));
             g_object_unref(G_OBJECT(image));
@@ -281,7 +284,8 @@ render(void)
 	#endif
 	
     gettimeofday(&start, NULL);
-    buffer = generateMandelbrot(upperLeft, lowerRight, maxIterations, WIDTH, HEIGHT);
+    field = iterateMandelbrot(upperLeft, lowerRight, maxIterations, WIDTH, HEIGHT);
+    buffer = colorizeMandelbrot(field, maxIterations, WIDTH, HEIGHT);
     image = convertColorArray(buffer);
     gettimeofday(&stop, NULL);
     gtk_image_set_from_pixbuf(GTK_IMAGE(imgSet), image);
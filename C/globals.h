@@ -18,6 +18,10 @@
 #define WIDTH 1024
 #define HEIGHT 768
 #define RADIUS 2
+#define PRECISION_MARGIN 16
+#define DISTANCE_RADIUS 100
+#define DISTANCE_RAMP 2.0f
+#define DISTANCE_FIRST_STEP 32
 #define ZOOM 0.4f
 #define INITIAL_UPPERLEFT (-2.5+1.5*I)
 #define INITIAL_LOWERRIGHT (1-1.5*I)
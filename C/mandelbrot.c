@@ -15,6 +15,62 @@
  */
 #include "mandelbrot.h"
 #include "stdio.h"
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+
+// Iteration, bei der z zum ersten Mal für die Erkennung periodischer Folgen gespeichert wird
+#define PERIODICITY_FIRST_CHECK 16
+
+/*
+ * Logarithmus zur Basis 2 für positive, endliche Zahlen ohne libm: der Exponent kommt aus
+ * den Bits, die Mantisse m in [sqrt(1/2), sqrt(2)) geht über die Reihe
+ * ln(m) = 2 atanh(s) = 2 (s + s^3/3 + s^5/5 + ...) mit s = (m-1)/(m+1), |s| < 0.172.
+ * Der erste weggelassene Term ist kleiner als 1e-11.
+ *
+ * Arguments:
+ *  x - Die Zahl
+ *
+ * Returns:
+ *  log2(x)
+ */
+static inline double fastLog2(double x)
+{
+	uint64_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	int exponent = (int)((bits >> 52) & 0x7FF) - 1023;
+	bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+	double m;
+	memcpy(&m, &bits, sizeof(m));
+
+	// Mantissen ab sqrt(2) halbieren, damit |s| klein bleibt
+	if (m > 1.4142135623730951)
+	{
+		m *= 0.5;
+		exponent++;
+	}
+
+	double s = (m - 1) / (m + 1);
+	double s2 = s * s;
+	double series = 1 + s2 * (1.0/3 + s2 * (0.2 + s2 * (1.0/7 + s2 * (1.0/9 + s2 * (1.0/11)))));
+	return exponent + 2.8853900817779268 * s * series;   // 2 / ln(2)
+}
+
+/*
+ * Berechnet den Smooth-Coloring-Wert eines entkommenen Punktes
+ *
+ * Arguments:
+ *  iteration - Anzahl der Iterationen bis zum Verlassen des Radius
+ *  magnitude - Quadrat des Betrags der ersten Zahl außerhalb des Radius
+ *
+ * Returns:
+ *  Die geglättete Iterationszahl
+ */
+static inline float smoothIteration(int iteration, double magnitude)
+{
+	// log(log|z| / log 2) / log 2 = log2(log2(|z|^2) / 2), ohne Wurzel und ohne libm
+	return iteration + 1.0 - fastLog2(fastLog2(magnitude) * 0.5);
+}
 
 /*
  * Addiert zwei komplexe Zahlen
@@ -81,19 +137,67 @@ float complex_abs (complex float c)
 	return sqrt(pow(crealf(c),2.0f) + pow(cimagf(c),2.0f));
 }
 
+/*
+ * Addiert zwei komplexe Zahlen in doppelter Genauigkeit
+ *
+ * Arguments:
+ *  a - erster Summand
+ *  b - zweiter Summand
+ * 
+ * Returns:
+ *  Die Summe der beiden komplexen Zahlen
+ */
+complex double complex_add_double (complex double a, complex double b)
+{
+	double x = creal(a)+creal(b);
+	double y = cimag(a)+cimag(b);
+	return x + y*I;
+}
+
+/*
+ * Multipliziert zwei komplexe Zahlen in doppelter Genauigkeit
+ *
+ * Arguments:
+ *  a - erster Faktor
+ *  b - zweiter Faktor
+ * 
+ * Returns:
+ *  Das Produkt der beiden komplexen Zahlen
+ */
+complex double complex_mul_double (complex double a, complex double b)
+{
+	double x = creal(a)*creal(b) - cimag(a)*cimag(b);
+	double y = creal(a)*cimag(b) + cimag(a)*creal(b);
+	return x + y*I;
+}
+
+/*
+ * Berechnet den Betrag einer komplexen Zahl in doppelter Genauigkeit
+ *
+ * Arguments:
+ *  c - komplexe Zahl
+ * 
+ * Returns:
+ *  Der Betrag der komplexen Zahl
+ */
+double complex_abs_double (complex double c)
+{
+	return sqrt(creal(c)*creal(c) + cimag(c)*cimag(c));
+}
+
 /*
  * Calculates a color mapping for a given iteration number by exploiting the
  * YUV color space. Returns the color as 8-bit unsigned char per channel (RGB).
  *
  * Arguments:
- *	index - Number of iterations that resulted from iterating the Mandelbrot series.
+ *	index - (Smoothed) number of iterations that resulted from iterating the Mandelbrot series.
  *	maxIterations - Parameter that was also used for series iteration.
  *
  * Returns:
  *	The associated color as an array of 3 8-bit unsigned char values.
  */
 void
-colorMapYUV(int index, int maxIterations, unsigned char* color)
+colorMapYUV(float index, int maxIterations, unsigned char* color)
 {
     // Wenn die komplexe Zahl Teil der Mandelbrotmenge ist, wird sie schwarz eingefärbt
 	if (index == maxIterations) {
@@ -106,8 +210,8 @@ colorMapYUV(int index, int maxIterations, unsigned char* color)
 	// Farbschema anwenden
     float y,u,v;
     y = 0.2f;
-    u = -1.0f + 2.0f * ((float)index / (float)maxIterations);
-    v = 0.5f - ((float)index / (float)maxIterations);
+    u = -1.0f + 2.0f * (index / (float)maxIterations);
+    v = 0.5f - (index / (float)maxIterations);
 	
 	// YUV -> RGB
 	float r,g,b;
@@ -121,6 +225,27 @@ colorMapYUV(int index, int maxIterations, unsigned char* color)
 	color[2] = (unsigned char) (b*255.0f);
 }
 
+/*
+ * Prüft, ob ein Punkt in der Hauptkardioide oder im Kreis der Periode 2 links davon
+ * liegt. Diese Punkte gehören sicher zur Mandelbrotmenge.
+ *
+ * Arguments:
+ *  re - Realteil des Punkts
+ *  im - Imaginärteil des Punkts
+ *
+ * Returns:
+ *  1 wenn der Punkt in der Kardioide oder im Kreis liegt, sonst 0
+ */
+static int
+insideCardioidOrBulb(double re, double im)
+{
+	double im2 = im * im;
+	double xq = re - 0.25;
+	double q = xq * xq + im2;
+	double xb = re + 1;
+	return q * (q + xq) <= 0.25 * im2 || xb * xb + im2 <= 0.0625;
+}
+
 /*
  * Executes the complex series for a given parameter c for up to maxIterations
  * and saves the last series component in last.
@@ -129,66 +254,402 @@ colorMapYUV(int index, int maxIterations, unsigned char* color)
  *  c - Additive component (complex number) for Mandelbrot series.
  *	maxIterations - Maximum number of iterations that are executed to determine a series' boundedness
  *	last - Pointer to a complex float number that can be used for storing the last component in a series - useful for color mapping
+ *	distance - If not NULL, the derivative dz/dc is iterated as well and distance receives the estimated
+ *	           distance 2|z|ln|z| / |dz/dc| of c to the Mandelbrot set (0 inside)
  *
  * Returns:
- *	The number of iterations that were executed before the series escaped our
- *	circle or - if the point is part of the Mandelbrot set a special
- *	(user-defined) value.
+ *	The (smoothed) number of iterations that were executed before the series
+ *	escaped our circle or - if the point is part of the Mandelbrot set -
+ *	maxIterations.
  */
-int
-testEscapeSeriesForPoint(complex float c, int maxIterations, complex float * last)
+float
+testEscapeSeriesForPoint(complex float c, int maxIterations, complex float * last, float * distance)
 {
     complex float z = 0.0f + 0.0f*I;
+    complex float dz = 0.0f + 0.0f*I;
 	int iteration = 0;
+
+	// Die Abstandsschätzung ist erst bei größerem |z| genau genug
+	float radius = distance ? DISTANCE_RADIUS : RADIUS;
+
+	// Punkte in der Kardioide und im Kreis müssen nicht iteriert werden
+	if (insideCardioidOrBulb(creal(c), cimag(c)))
+	{
+		if (distance)
+			*distance = 0;
+		return maxIterations;
+	}
+
+	// Zuletzt gespeichertes Folgenglied für die Erkennung periodischer Folgen, anfangs z_0
+	complex float saved = z;
+	int checkAt = PERIODICITY_FIRST_CHECK;
 	
 	// Mandelbrotfolge durchgehen bis wir die Anzahl der erlaubten Iterationen erreicht haben oder der Betrag den Radius übersteigt
-	while ((complex_abs(z) <= RADIUS) && (iteration < maxIterations))
+	while ((complex_abs(z) <= radius) && (iteration < maxIterations))
 	{
+		// dz_{n+1} = 2 z_n dz_n + 1
+		if (distance)
+			dz = complex_add(complex_mul(complex_add(z, z), dz), 1.0f);
+
 		z = complex_add(complex_mul(z,z), c);
 		iteration++;
+
+		// Kommt z exakt wieder, wiederholt sich die restliche Folge und der Punkt entkommt nie
+		if (creal(z) == creal(saved) && cimag(z) == cimag(saved))
+		{
+			iteration = maxIterations;
+			break;
+		}
+
+		// z wird in immer größeren Abständen gespeichert (Brent)
+		if (iteration == checkAt)
+		{
+			saved = z;
+			checkAt *= 2;
+		}
 	}
 	
+	if (distance)
+		*distance = iteration < maxIterations ? 2 * complex_abs(z) * log(complex_abs(z)) / complex_abs(dz) : 0;
+
 	// Wenn die komplexe Zahl c nicht in der Mandelbrot-Menge liegt, smooth coloring anwenden
 	if (iteration < maxIterations)
 	{
-		iteration += 1.0f - (log(log(complex_abs(z)) / log(2.0f)) / log(2.0f));
+		return smoothIteration(iteration, crealf(z)*crealf(z) + cimagf(z)*cimagf(z));
 	}
 	
 	return iteration;
 }
 
 /*
- * Generates an image of a Mandelbrot set.
+ * Same as testEscapeSeriesForPoint, but iterates in double precision for
+ * zooms that float can no longer resolve.
  */
-unsigned char *
-generateMandelbrot(
-    complex float upperLeft, 
-    complex float lowerRight, 
-    int maxIterations, 
-    int width, 
+float
+testEscapeSeriesForPointDouble(complex double c, int maxIterations, complex double * last, float * distance)
+{
+    complex double z = 0.0 + 0.0*I;
+    complex double dz = 0.0 + 0.0*I;
+	int iteration = 0;
+
+	// Die Abstandsschätzung ist erst bei größerem |z| genau genug
+	double radius = distance ? DISTANCE_RADIUS : RADIUS;
+
+	// Punkte in der Kardioide und im Kreis müssen nicht iteriert werden
+	if (insideCardioidOrBulb(creal(c), cimag(c)))
+	{
+		if (distance)
+			*distance = 0;
+		return maxIterations;
+	}
+
+	// Zuletzt gespeichertes Folgenglied für die Erkennung periodischer Folgen, anfangs z_0
+	complex double saved = z;
+	int checkAt = PERIODICITY_FIRST_CHECK;
+	
+	// Mandelbrotfolge durchgehen bis wir die Anzahl der erlaubten Iterationen erreicht haben oder der Betrag den Radius übersteigt
+	while ((complex_abs_double(z) <= radius) && (iteration < maxIterations))
+	{
+		// dz_{n+1} = 2 z_n dz_n + 1
+		if (distance)
+			dz = complex_add_double(complex_mul_double(complex_add_double(z, z), dz), 1.0);
+
+		z = complex_add_double(complex_mul_double(z,z), c);
+		iteration++;
+
+		// Kommt z exakt wieder, wiederholt sich die restliche Folge und der Punkt entkommt nie
+		if (creal(z) == creal(saved) && cimag(z) == cimag(saved))
+		{
+			iteration = maxIterations;
+			break;
+		}
+
+		// z wird in immer größeren Abständen gespeichert (Brent)
+		if (iteration == checkAt)
+		{
+			saved = z;
+			checkAt *= 2;
+		}
+	}
+	
+	if (distance)
+		*distance = iteration < maxIterations ? 2 * complex_abs_double(z) * log(complex_abs_double(z)) / complex_abs_double(dz) : 0;
+
+	// Wenn die komplexe Zahl c nicht in der Mandelbrot-Menge liegt, smooth coloring anwenden
+	if (iteration < maxIterations)
+	{
+		return smoothIteration(iteration, creal(z)*creal(z) + cimag(z)*cimag(z));
+	}
+	
+	return iteration;
+}
+
+/*
+ * Checks whether float can still resolve the pixels of a viewport: the distance
+ * between two pixels has to be at least PRECISION_MARGIN float steps at the
+ * magnitude of the coordinates, otherwise neighbouring pixels collapse into blocks.
+ */
+static int
+needsDoublePrecision(
+    complex double upperLeft,
+    complex double lowerRight,
+    int width,
     int height)
 {
-    // Allocate image buffer, row-major order, 3 channels.
-    unsigned char *image = malloc(height * width * 3);
+    double dx = fabs(creal(lowerRight) - creal(upperLeft)) / width;
+    double dy = fabs(cimag(lowerRight) - cimag(upperLeft)) / height;
+    double magnitude = fmax(fmax(fabs(creal(upperLeft)), fabs(cimag(upperLeft))),
+                            fmax(fabs(creal(lowerRight)), fabs(cimag(lowerRight))));
+
+    return fmin(dx, dy) < PRECISION_MARGIN * FLT_EPSILON * fmax(magnitude, 1.0);
+}
+
+/*
+ * Iterates the Mandelbrot series for every pixel of a tile of a view.
+ */
+void
+iterateMandelbrotTile(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int tileX,
+    int tileY,
+    int tileWidth,
+    int tileHeight,
+    float *iterations,
+    size_t stride)
+{
+    // Ab einer gewissen Zoomstufe reicht float nicht mehr aus, dann wird in double gerechnet
+    if (needsDoublePrecision(upperLeft, lowerRight, width, height)) {
+        complex double cur = upperLeft; // Der Ausgangspunkt
+        double dx = (creal(lowerRight) - creal(upperLeft))/width;  // die "Schrittgröße" für eine x-Iteration
+        double dy = (cimag(lowerRight) - cimag(upperLeft))/height; // die "Schrittgröße" für eine y-Iteration
+
+        for(int y = tileY; y < tileY + tileHeight; y++) {
+            for(int x = tileX; x < tileX + tileWidth; x++) {
+                // komplexe Zahl für diesen Pixel berechnen
+                complex double c = dx*x + (dy*y)*I;
+                c = complex_add_double(c, cur);
+
+                // Mandelbrotfolge für diese Zahl durchgehen
+                iterations[(y - tileY) * stride + (x - tileX)] = testEscapeSeriesForPointDouble(c, maxIterations, 0, 0);
+            }
+        }
+
+        return;
+    }
+
     complex float cur = upperLeft; // Der Ausgangspunkt
     float dx = (crealf(lowerRight) - crealf(upperLeft))/width;  // die "Schrittgröße" für eine x-Iteration
     float dy = (cimagf(lowerRight) - cimagf(upperLeft))/height; // die "Schrittgröße" für eine y-Iteration
 
-    for(int y = 0; y < height; y++) {
-        for(int x = 0; x < width; x++) {
+    for(int y = tileY; y < tileY + tileHeight; y++) {
+        for(int x = tileX; x < tileX + tileWidth; x++) {
 			// komplexe Zahl für diesen Pixel berechnen
 			complex float c = dx*x + (dy*y)*I;
 			c = complex_add(c, cur);
 			
 			// Mandelbrotfolge für diese Zahl durchgehen
-			int index = testEscapeSeriesForPoint(c, maxIterations, 0);
-			
-			// Pixel einfärben
-            int offset = (y * width + x) * 3;
-            colorMapYUV(index, maxIterations, image + offset);
+			iterations[(y - tileY) * stride + (x - tileX)] = testEscapeSeriesForPoint(c, maxIterations, 0, 0);
         }
     }
+}
+
+/*
+ * Iterates the Mandelbrot series for every pixel of a view.
+ */
+float *
+iterateMandelbrot(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height)
+{
+    // Allocate iteration buffer, row-major order.
+    float *iterations = malloc((size_t)width * height * sizeof(float));
+    iterateMandelbrotTile(upperLeft, lowerRight, maxIterations, width, height, 0, 0, width, height, iterations, width);
+    return iterations;
+}
+
+/*
+ * Renders a tile of a view into a caller-provided buffer.
+ */
+void
+renderMandelbrotTile(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int tileX,
+    int tileY,
+    int tileWidth,
+    int tileHeight,
+    unsigned char *image,
+    size_t stride)
+{
+    // Zeilenweise iterieren und einfärben, so braucht es nur den Zwischenspeicher für eine Zeile
+    float *row = malloc(tileWidth * sizeof(float));
+
+    for(int y = 0; y < tileHeight; y++) {
+        iterateMandelbrotTile(upperLeft, lowerRight, maxIterations, width, height, tileX, tileY + y, tileWidth, 1, row, tileWidth);
+        for(int x = 0; x < tileWidth; x++) {
+            colorMapYUV(row[x], maxIterations, image + y * stride + x * 3);
+        }
+    }
+
+    free(row);
+}
+
+/*
+ * Turns an iteration field into RGB colours.
+ */
+unsigned char *
+colorizeMandelbrot(
+    const float *iterations,
+    int maxIterations,
+    int width,
+    int height)
+{
+    // Allocate image buffer, row-major order, 3 channels.
+    unsigned char *image = malloc((size_t)width * height * 3);
+
+    for(size_t p = 0; p < (size_t)width * height; p++) {
+        colorMapYUV(iterations[p], maxIterations, image + p * 3);
+    }
 
     return image;
 }
 
+/*
+ * Füllt die Pixel, die in der Koebe-Scheibe um einen iterierten Pixel liegen. Die Scheibe
+ * mit einem Viertel des geschätzten Abstands liegt sicher außerhalb der Menge, jeder Pixel
+ * darin ist mindestens so weit entfernt wie vom Rand der Scheibe.
+ *
+ * Arguments:
+ *  distances - Abstände aller Pixel in Pixeln, negativ für noch offene Pixel
+ *  width, height - Größe des Ausschnitts
+ *  x, y - Mittelpunkt der Scheibe
+ *  radius - Radius der Scheibe in der komplexen Ebene
+ *  dx, dy - Abstand zweier Pixel
+ *  pixel - Größe eines Pixels, Einheit der Abstände
+ */
+static void
+fillDisc(float *distances, int width, int height, int x, int y, double radius, double dx, double dy, double pixel)
+{
+    // Nur Pixel, die sicher ganz weiß werden, die übrigen brauchen ihre eigene Schätzung
+    double limit = DISTANCE_RAMP * pixel;
+    if(radius <= limit) {
+        return;
+    }
+
+    int rx = (int)(radius / fabs(dx));
+    int ry = (int)(radius / fabs(dy));
+    for(int j = y - ry > 0 ? -ry : -y; j <= ry && y + j < height; j++) {
+        for(int i = x - rx > 0 ? -rx : -x; i <= rx && x + i < width; i++) {
+            float *d = &distances[(size_t)(y + j) * width + x + i];
+            if(*d >= 0) {
+                continue;
+            }
+            double bound = radius - hypot(i * dx, j * dy);
+            if(bound >= limit) {
+                *d = bound / pixel;
+            }
+        }
+    }
+}
+
+/*
+ * Estimates the distance of every pixel of a view to the Mandelbrot set.
+ */
+float *
+estimateMandelbrotDistance(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int fillDiscs)
+{
+    float *distances = malloc((size_t)width * height * sizeof(float));
+    for(size_t p = 0; p < (size_t)width * height; p++) {
+        distances[p] = -1;
+    }
+
+    int useDouble = needsDoublePrecision(upperLeft, lowerRight, width, height);
+    double dx = (creal(lowerRight) - creal(upperLeft))/width;
+    double dy = (cimag(lowerRight) - cimag(upperLeft))/height;
+    double pixel = fmax(fabs(dx), fabs(dy));
+
+    // Von grob nach fein: die ersten, weit auseinander liegenden Pixel füllen mit ihren Scheiben
+    // den Großteil des Äußeren, bevor die Pixel dazwischen dran sind
+    for(int step = fillDiscs ? DISTANCE_FIRST_STEP : 1; step >= 1; step /= 2) {
+        for(int y = 0; y < height; y += step) {
+            for(int x = 0; x < width; x += step) {
+                if(distances[(size_t)y * width + x] >= 0) {
+                    continue;
+                }
+
+                float distance;
+                if(useDouble) {
+                    complex double c = (creal(upperLeft) + dx*x) + (cimag(upperLeft) + dy*y)*I;
+                    testEscapeSeriesForPointDouble(c, maxIterations, 0, &distance);
+                } else {
+                    complex float c = ((float)creal(upperLeft) + (float)dx*x) + ((float)cimag(upperLeft) + (float)dy*y)*I;
+                    testEscapeSeriesForPoint(c, maxIterations, 0, &distance);
+                }
+
+                distances[(size_t)y * width + x] = distance / pixel;
+                if(fillDiscs) {
+                    fillDisc(distances, width, height, x, y, distance / 4, dx, dy, pixel);
+                }
+            }
+        }
+    }
+
+    return distances;
+}
+
+/*
+ * Turns a distance field into grey levels.
+ */
+unsigned char *
+colorizeDistance(
+    const float *distances,
+    int width,
+    int height)
+{
+    unsigned char *image = malloc((size_t)width * height * 3);
+
+    // Schwarz in der Menge, aufhellend bis DISTANCE_RAMP Pixel Abstand, danach weiß
+    for(size_t p = 0; p < (size_t)width * height; p++) {
+        float shade = distances[p] < DISTANCE_RAMP ? distances[p] / DISTANCE_RAMP : 1;
+        unsigned char grey = (unsigned char)(255 * shade + 0.5f);
+        image[p * 3 + 0] = grey;
+        image[p * 3 + 1] = grey;
+        image[p * 3 + 2] = grey;
+    }
+
+    return image;
+}
+
+/*
+ * Generates an image of a Mandelbrot set.
+ */
+unsigned char *
+generateMandelbrot(
+    complex double upperLeft, 
+    complex double lowerRight, 
+    int maxIterations, 
+    int width, 
+    int height)
+{
+    float *iterations = iterateMandelbrot(upperLeft, lowerRight, maxIterations, width, height);
+    unsigned char *image = colorizeMandelbrot(iterations, maxIterations, width, height);
+
+    free(iterations);
+    return image;
+}
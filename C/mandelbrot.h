@@ -24,6 +24,8 @@
  * Generates an image of a Mandelbrot set in the given bounded complex plane
  * for a given sampling specified in width times height pixels. Uses colormapping
  * to determine the pixel's color from its iteration return value.
+ * Iterates in float as long as float can resolve the pixels and switches to
+ * double for deeper zooms.
  * 
  * Arguments:
  *	upperLeft - Upper left corner of the complex plane for calculation
@@ -38,10 +40,142 @@
  */
 unsigned char *
 generateMandelbrot(
-    complex float upperLeft,
-    complex float lowerRight, 
+    complex double upperLeft,
+    complex double lowerRight, 
     int maxIterations, 
     int width, 
     int height);
 
+/*
+ * Iterates the Mandelbrot series for every pixel of a view, without colouring
+ * it. This is the expensive part of generateMandelbrot; the result can be kept
+ * and coloured (again) with colorizeMandelbrot.
+ *
+ * Arguments:
+ *	upperLeft, lowerRight, maxIterations, width, height - see generateMandelbrot
+ *
+ * Returns:
+ *   An array of width * height floats in row-major order holding the smoothed
+ *   iteration number of every pixel, exactly maxIterations for pixels inside
+ *   the Mandelbrot set.
+ */
+float *
+iterateMandelbrot(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Iterates the tile of tileWidth times tileHeight pixels starting at pixel
+ * (tileX, tileY) of the view into a buffer the caller owns. Pixel (x, y) of
+ * the tile gets the same value as pixel (tileX + x, tileY + y) of
+ * iterateMandelbrot.
+ *
+ * Arguments:
+ *	upperLeft, lowerRight, maxIterations, width, height - The whole view, see generateMandelbrot
+ *	tileX, tileY - First pixel of the tile
+ *	tileWidth, tileHeight - Size of the tile in pixels
+ *	iterations - Receives the smoothed iteration numbers of the tile
+ *	stride - Distance between two rows of the tile in iterations in floats (at least tileWidth)
+ */
+void
+iterateMandelbrotTile(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int tileX,
+    int tileY,
+    int tileWidth,
+    int tileHeight,
+    float *iterations,
+    size_t stride);
+
+/*
+ * Like iterateMandelbrotTile, but colours the tile like generateMandelbrot.
+ *
+ * Arguments:
+ *	image - Receives the RGB 8-bit values of the tile
+ *	stride - Distance between two rows of the tile in image in bytes (at least tileWidth * 3)
+ */
+void
+renderMandelbrotTile(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int tileX,
+    int tileY,
+    int tileWidth,
+    int tileHeight,
+    unsigned char *image,
+    size_t stride);
+
+/*
+ * Colours an iteration field as returned by iterateMandelbrot.
+ *
+ * Arguments:
+ *	iterations - Smoothed iteration number of every pixel in row-major order
+ *	maxIterations - The limit the field was iterated with, pixels with this value are black
+ *	width - Width of the field in pixels
+ *	height - Height of the field in pixels
+ *
+ * Returns:
+ *   An array of RGB 8-bit values (unsigned char), see generateMandelbrot.
+ */
+unsigned char *
+colorizeMandelbrot(
+    const float *iterations,
+    int maxIterations,
+    int width,
+    int height);
+
+/*
+ * Estimates the distance of every pixel of a view to the Mandelbrot set from
+ * the derivative dz/dc (2|z|ln|z| / |dz/dc| at escape). Pixels closer than a
+ * pixel show the thin filaments that escape-time colouring misses.
+ *
+ * With fillDiscs, a quarter of the estimate of an iterated pixel is a disc
+ * that is certainly outside the set (Koebe 1/4 theorem). Every pixel inside
+ * that disc gets its distance to the rim of the disc as a lower bound instead
+ * of being iterated. Only pixels that this makes at least DISTANCE_RAMP pixels
+ * away are filled, so colorizeDistance gives them the same white as iterated
+ * pixels that far away. Pixels are iterated from a coarse to a fine grid, so
+ * that few iterated pixels cover most of the exterior.
+ *
+ * Arguments:
+ *	upperLeft, lowerRight, maxIterations, width, height - see generateMandelbrot
+ *	fillDiscs - If not 0, pixels inside the discs are filled instead of iterated
+ *
+ * Returns:
+ *   An array of width * height floats in row-major order holding the
+ *   distance of every pixel in pixels (the larger side of a pixel), 0 for
+ *   pixels in the set.
+ */
+float *
+estimateMandelbrotDistance(
+    complex double upperLeft,
+    complex double lowerRight,
+    int maxIterations,
+    int width,
+    int height,
+    int fillDiscs);
+
+/*
+ * Colours a distance field as returned by estimateMandelbrotDistance: black in
+ * the set, brightening up to white at DISTANCE_RAMP pixels away.
+ *
+ * Returns:
+ *   An array of RGB 8-bit values (unsigned char), see generateMandelbrot.
+ */
+unsigned char *
+colorizeDistance(
+    const float *distances,
+    int width,
+    int height);
+
 #endif /* MANDELBROT_HEADER */
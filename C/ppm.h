@@ -14,6 +14,8 @@
 #ifndef PPM_HEADER
 #define PPM_HEADER
 
+#include <stdio.h>
+
 /*
  * Representation of an image.
  */
@@ -23,14 +25,61 @@ struct PPM {
 	unsigned char* data;
 };
 
+/*
+ * File formats for exportPPM.
+ */
+#define PPM_BINARY 0	// P6, the bytes as they are
+#define PPM_ASCII 1	// P3, one decimal number per byte
+
 /*
  * Saves a PPM file (3-channels, each 8-bit unsigned char) to disk into a file named path.
  * 
  * Arguments:
  *	filename - The filename including path for the image file.
  *	image - PPM structure containing width, height and actual data of an image.
+ *	format - PPM_BINARY (P6, written a row at a time) or PPM_ASCII (P3, much slower)
  */
 void
-exportPPM(const char *filename, struct PPM *image);
+exportPPM(const char *filename, struct PPM *image, int format);
+
+/*
+ * Starts a binary PPM file (P6) that is written band by band with
+ * writePPMBand, for pictures too large to be held in memory as a whole.
+ *
+ * Arguments:
+ *	filename - The filename including path for the image file.
+ *	width, height - Size of the whole picture in pixels.
+ *
+ * Returns:
+ *   The open file, NULL if it cannot be written.
+ */
+FILE *
+beginPPM(const char *filename, size_t width, size_t height);
+
+/*
+ * Appends a band of rows to a file started with beginPPM. Like exportPPM, the
+ * file holds the bottom row of the picture first, so the bands have to be
+ * written from the bottom of the picture to the top.
+ *
+ * Arguments:
+ *	img - The file from beginPPM.
+ *	data - RGB 8-bit values of the band in row-major order, top row first.
+ *	width - Width of the picture in pixels.
+ *	rows - Number of rows in the band.
+ *
+ * Returns:
+ *   0 on success, -1 if the rows cannot be written.
+ */
+int
+writePPMBand(FILE *img, const unsigned char *data, size_t width, size_t rows);
+
+/*
+ * Closes a file started with beginPPM.
+ *
+ * Returns:
+ *   0 on success, -1 if the last rows cannot be written.
+ */
+int
+endPPM(FILE *img);
 
 #endif /* PPM_HEADER */